@@ -36,11 +36,13 @@
         global Fq_rawAdd
         global Fq_rawSub
         global Fq_rawNeg
-        global Fq_rawMMul
-        global Fq_rawMMul1
-        global Fq_rawMSquare
-        global Fq_rawToMontgomery
-        global Fq_rawFromMontgomery
+        global Fq_rawMMulAdx
+        global Fq_rawMMul1Adx
+        global Fq_rawMSquareAdx
+        global Fq_rawToMontgomeryAdx
+        global Fq_rawFromMontgomeryAdx
+        global Fq_rawMulWideAdx
+        global Fq_rawMReduceWideAdx
         global Fq_rawIsEq
         global Fq_rawIsZero
         global Fq_rawShr
@@ -365,7 +367,7 @@ Fq_longErr:
 
 
 
-Fq_rawMMul:
+Fq_rawMMulAdx:
     push r15
     push r14
     push r13
@@ -533,7 +535,7 @@ Fq_rawMMul_done:
     pop r14
     pop r15
     ret
-Fq_rawMSquare:
+Fq_rawMSquareAdx:
     push r15
     push r14
     push r13
@@ -701,7 +703,7 @@ Fq_rawMSquare_done:
     pop r14
     pop r15
     ret
-Fq_rawMMul1:
+Fq_rawMMul1Adx:
     push r15
     push r14
     push r13
@@ -824,7 +826,7 @@ Fq_rawMMul1_done:
     pop r14
     pop r15
     ret
-Fq_rawFromMontgomery:
+Fq_rawFromMontgomeryAdx:
     push r15
     push r14
     push r13
@@ -942,6 +944,213 @@ Fq_rawFromMontgomery_done:
     pop r14
     pop r15
     ret
+Fq_rawMulWideAdx:
+    push r15
+    push r14
+    push r13
+    push r12
+    mov rcx,rdx
+    xor r10,r10
+
+; FirstRow
+    mov rdx,[rsi + 0]
+    mulx rax,r11,[rcx]
+    mulx r8,r12,[rcx +8]
+    adcx r12,rax
+    mulx rax,r13,[rcx +16]
+    adcx r13,r8
+    mulx r8,r14,[rcx +24]
+    adcx r14,rax
+    mov r15,r10
+    adcx r15,r8
+    mov [rdi + 0],r11
+
+; Row
+    mov rdx,[rsi + 8]
+    xor r11,r11
+    mulx r8,rax,[rcx]
+    adcx r12,rax
+    adox r13,r8
+    mulx r8,rax,[rcx +8]
+    adcx r13,rax
+    adox r14,r8
+    mulx r8,rax,[rcx +16]
+    adcx r14,rax
+    adox r15,r8
+    mulx r8,rax,[rcx +24]
+    adcx r15,rax
+    adox r11,r8
+    adcx r11,r10
+    mov [rdi + 8],r12
+
+; Row
+    mov rdx,[rsi + 16]
+    xor r12,r12
+    mulx r8,rax,[rcx]
+    adcx r13,rax
+    adox r14,r8
+    mulx r8,rax,[rcx +8]
+    adcx r14,rax
+    adox r15,r8
+    mulx r8,rax,[rcx +16]
+    adcx r15,rax
+    adox r11,r8
+    mulx r8,rax,[rcx +24]
+    adcx r11,rax
+    adox r12,r8
+    adcx r12,r10
+    mov [rdi + 16],r13
+
+; Row
+    mov rdx,[rsi + 24]
+    xor r13,r13
+    mulx r8,rax,[rcx]
+    adcx r14,rax
+    adox r15,r8
+    mulx r8,rax,[rcx +8]
+    adcx r15,rax
+    adox r11,r8
+    mulx r8,rax,[rcx +16]
+    adcx r11,rax
+    adox r12,r8
+    mulx r8,rax,[rcx +24]
+    adcx r12,rax
+    adox r13,r8
+    adcx r13,r10
+    mov [rdi + 24],r14
+    mov [rdi + 32],r15
+    mov [rdi + 40],r11
+    mov [rdi + 48],r12
+    mov [rdi + 56],r13
+    pop r12
+    pop r13
+    pop r14
+    pop r15
+    ret
+Fq_rawMReduceWideAdx:
+    push r15
+    push r14
+    push r13
+    push r12
+    mov rcx,rdx
+    mov r9,[ np ]
+    xor r10,r10
+
+; FirstLoop
+    mov r11,[rsi +0]
+    mov r12,[rsi +8]
+    mov r13,[rsi +16]
+    mov r14,[rsi +24]
+    mov r15,r10
+; SecondLoop
+    mov rdx,r9
+    mulx rax,rdx,r11
+    mulx r8,rax,[q]
+    adcx rax,r11
+    mulx rax,r11,[q +8]
+    adcx r11,r8
+    adox r11,r12
+    mulx r8,r12,[q +16]
+    adcx r12,rax
+    adox r12,r13
+    mulx rax,r13,[q +24]
+    adcx r13,r8
+    adox r13,r14
+    mov r14,r10
+    adcx r14,rax
+    adox r14,r15
+
+    mov r15,r10
+; SecondLoop
+    mov rdx,r9
+    mulx rax,rdx,r11
+    mulx r8,rax,[q]
+    adcx rax,r11
+    mulx rax,r11,[q +8]
+    adcx r11,r8
+    adox r11,r12
+    mulx r8,r12,[q +16]
+    adcx r12,rax
+    adox r12,r13
+    mulx rax,r13,[q +24]
+    adcx r13,r8
+    adox r13,r14
+    mov r14,r10
+    adcx r14,rax
+    adox r14,r15
+
+    mov r15,r10
+; SecondLoop
+    mov rdx,r9
+    mulx rax,rdx,r11
+    mulx r8,rax,[q]
+    adcx rax,r11
+    mulx rax,r11,[q +8]
+    adcx r11,r8
+    adox r11,r12
+    mulx r8,r12,[q +16]
+    adcx r12,rax
+    adox r12,r13
+    mulx rax,r13,[q +24]
+    adcx r13,r8
+    adox r13,r14
+    mov r14,r10
+    adcx r14,rax
+    adox r14,r15
+
+    mov r15,r10
+; SecondLoop
+    mov rdx,r9
+    mulx rax,rdx,r11
+    mulx r8,rax,[q]
+    adcx rax,r11
+    mulx rax,r11,[q +8]
+    adcx r11,r8
+    adox r11,r12
+    mulx r8,r12,[q +16]
+    adcx r12,rax
+    adox r12,r13
+    mulx rax,r13,[q +24]
+    adcx r13,r8
+    adox r13,r14
+    mov r14,r10
+    adcx r14,rax
+    adox r14,r15
+
+; HighHalf
+    add r11,[rsi +32]
+    adc r12,[rsi +40]
+    adc r13,[rsi +48]
+    adc r14,[rsi +56]
+
+;comparison
+    cmp r14,[q + 24]
+    jc Fq_rawMReduceWide_done
+    jnz Fq_rawMReduceWide_sq
+    cmp r13,[q + 16]
+    jc Fq_rawMReduceWide_done
+    jnz Fq_rawMReduceWide_sq
+    cmp r12,[q + 8]
+    jc Fq_rawMReduceWide_done
+    jnz Fq_rawMReduceWide_sq
+    cmp r11,[q + 0]
+    jc Fq_rawMReduceWide_done
+    jnz Fq_rawMReduceWide_sq
+Fq_rawMReduceWide_sq:
+    sub r11,[q +0]
+    sbb r12,[q +8]
+    sbb r13,[q +16]
+    sbb r14,[q +24]
+Fq_rawMReduceWide_done:
+    mov [rdi + 0],r11
+    mov [rdi + 8],r12
+    mov [rdi + 16],r13
+    mov [rdi + 24],r14
+    pop r12
+    pop r13
+    pop r14
+    pop r15
+    ret
 
 ;;;;;;;;;;;;;;;;;;;;;;
 ; rawToMontgomery
@@ -950,10 +1159,10 @@ Fq_rawFromMontgomery_done:
 ;   rdi <= Pointer destination element
 ;   rsi <= Pointer to src element
 ;;;;;;;;;;;;;;;;;;;;
-Fq_rawToMontgomery:
+Fq_rawToMontgomeryAdx:
     push    rdx
     lea     rdx, [R2]
-    call    Fq_rawMMul
+    call    Fq_rawMMulAdx
     pop     rdx
     ret
 
@@ -981,7 +1190,7 @@ toMontgomeryShort:
     cmp     rdx, 0
     js      negMontgomeryShort
 posMontgomeryShort:
-    call    Fq_rawMMul1
+    call    Fq_rawMMul1Adx
     sub     rdi, 8
             mov r11b, 0x40
         shl r11d, 24
@@ -990,7 +1199,7 @@ posMontgomeryShort:
 
 negMontgomeryShort:
     neg     rdx              ; Do the multiplication positive and then negate the result.
-    call    Fq_rawMMul1
+    call    Fq_rawMMul1Adx
     mov     rsi, rdi
     call    rawNegL
     sub     rdi, 8
@@ -1005,7 +1214,7 @@ toMontgomeryLong:
     add     rdi, 8
     add     rsi, 8
     lea     rdx, [R2]
-    call    Fq_rawMMul
+    call    Fq_rawMMulAdx
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0xC0
@@ -1037,7 +1246,7 @@ Fq_toNormal:
 toNormalLong:
     add     rdi, 8
     add     rsi, 8
-    call    Fq_rawFromMontgomery
+    call    Fq_rawFromMontgomeryAdx
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0x80
@@ -1070,7 +1279,7 @@ Fq_toLongNormal:
 toLongNormal_fromMontgomery:
     add     rdi, 8
     add     rsi, 8
-    call    Fq_rawFromMontgomery
+    call    Fq_rawFromMontgomeryAdx
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0x80
@@ -2337,7 +2546,7 @@ square_l1n:
 
         add rdi, 8
         add rsi, 8
-        call Fq_rawMSquare
+        call Fq_rawMSquareAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2346,7 +2555,7 @@ square_l1n:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         pop rsi
 
@@ -2359,7 +2568,7 @@ square_l1m:
 
         add rdi, 8
         add rsi, 8
-        call Fq_rawMSquare
+        call Fq_rawMSquareAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2431,7 +2640,7 @@ mul_l1ns2n:
         
         jns tmp_5
         neg rdx
-        call Fq_rawMMul1
+        call Fq_rawMMul1Adx
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2439,7 +2648,7 @@ mul_l1ns2n:
         
         jmp tmp_6
 tmp_5:
-        call Fq_rawMMul1
+        call Fq_rawMMul1Adx
         sub rdi, 8
         pop rsi
 tmp_6:
@@ -2450,7 +2659,7 @@ tmp_6:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         pop rsi
 
@@ -2465,7 +2674,7 @@ mul_l1ns2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2488,7 +2697,7 @@ mul_l1ms2n:
         
         jns tmp_7
         neg rdx
-        call Fq_rawMMul1
+        call Fq_rawMMul1Adx
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2496,7 +2705,7 @@ mul_l1ms2n:
         
         jmp tmp_8
 tmp_7:
-        call Fq_rawMMul1
+        call Fq_rawMMul1Adx
         sub rdi, 8
         pop rsi
 tmp_8:
@@ -2512,7 +2721,7 @@ mul_l1ms2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2539,7 +2748,7 @@ mul_s1nl2n:
         
         jns tmp_9
         neg rdx
-        call Fq_rawMMul1
+        call Fq_rawMMul1Adx
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2547,7 +2756,7 @@ mul_s1nl2n:
         
         jmp tmp_10
 tmp_9:
-        call Fq_rawMMul1
+        call Fq_rawMMul1Adx
         sub rdi, 8
         pop rsi
 tmp_10:
@@ -2558,7 +2767,7 @@ tmp_10:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         pop rsi
 
@@ -2577,7 +2786,7 @@ mul_s1nl2m:
         
         jns tmp_11
         neg rdx
-        call Fq_rawMMul1
+        call Fq_rawMMul1Adx
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2585,7 +2794,7 @@ mul_s1nl2m:
         
         jmp tmp_12
 tmp_11:
-        call Fq_rawMMul1
+        call Fq_rawMMul1Adx
         sub rdi, 8
         pop rsi
 tmp_12:
@@ -2604,7 +2813,7 @@ mul_s1ml2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2618,7 +2827,7 @@ mul_s1ml2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2639,7 +2848,7 @@ mul_l1nl2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2648,7 +2857,7 @@ mul_l1nl2n:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         pop rsi
 
@@ -2662,7 +2871,7 @@ mul_l1nl2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2679,7 +2888,7 @@ mul_l1ml2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2693,7 +2902,7 @@ mul_l1ml2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fq_rawMMul
+        call Fq_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
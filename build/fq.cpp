@@ -13,6 +13,103 @@ static mpz_t mask;
 static size_t nBits;
 static bool initialized = false;
 
+#if defined(USE_ASM) && defined(ARCH_X86_64)
+
+#include <cpuid.h>
+
+static const char *Fq_selectKernels();
+
+// The pointers start at resolvers that select the kernels first, so that
+// calls from static initializers of other files are safe too.
+static void Fq_resolveMMul(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB) {
+    Fq_selectKernels();
+    Fq_rawMMul(pRawResult, pRawA, pRawB);
+}
+
+static void Fq_resolveMSquare(FqRawElement pRawResult, const FqRawElement pRawA) {
+    Fq_selectKernels();
+    Fq_rawMSquare(pRawResult, pRawA);
+}
+
+static void Fq_resolveMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB) {
+    Fq_selectKernels();
+    Fq_rawMMul1(pRawResult, pRawA, pRawB);
+}
+
+static void Fq_resolveToMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA) {
+    Fq_selectKernels();
+    Fq_rawToMontgomery(pRawResult, pRawA);
+}
+
+static void Fq_resolveFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA) {
+    Fq_selectKernels();
+    Fq_rawFromMontgomery(pRawResult, pRawA);
+}
+
+static void Fq_resolveMulWide(FqRawWideElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB) {
+    Fq_selectKernels();
+    Fq_rawMulWide(pRawResult, pRawA, pRawB);
+}
+
+static void Fq_resolveMReduceWide(FqRawElement pRawResult, const FqRawWideElement pRawA) {
+    Fq_selectKernels();
+    Fq_rawMReduceWide(pRawResult, pRawA);
+}
+
+void (*Fq_rawMMul)(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB) = Fq_resolveMMul;
+void (*Fq_rawMSquare)(FqRawElement pRawResult, const FqRawElement pRawA) = Fq_resolveMSquare;
+void (*Fq_rawMMul1)(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB) = Fq_resolveMMul1;
+void (*Fq_rawToMontgomery)(FqRawElement pRawResult, const FqRawElement &pRawA) = Fq_resolveToMontgomery;
+void (*Fq_rawFromMontgomery)(FqRawElement pRawResult, const FqRawElement &pRawA) = Fq_resolveFromMontgomery;
+void (*Fq_rawMulWide)(FqRawWideElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB) = Fq_resolveMulWide;
+void (*Fq_rawMReduceWide)(FqRawElement pRawResult, const FqRawWideElement pRawA) = Fq_resolveMReduceWide;
+
+static const char *Fq_pickKernels() {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+    if ((ebx & bit_BMI2) && (ebx & bit_ADX)) {
+        Fq_rawMMul = Fq_rawMMulAdx;
+        Fq_rawMSquare = Fq_rawMSquareAdx;
+        Fq_rawMMul1 = Fq_rawMMul1Adx;
+        Fq_rawToMontgomery = Fq_rawToMontgomeryAdx;
+        Fq_rawFromMontgomery = Fq_rawFromMontgomeryAdx;
+        Fq_rawMulWide = Fq_rawMulWideAdx;
+        Fq_rawMReduceWide = Fq_rawMReduceWideAdx;
+        return "bmi2/adx";
+    }
+    Fq_rawMMul = Fq_baseline::Fq_rawMMul;
+    Fq_rawMSquare = Fq_baseline::Fq_rawMSquare;
+    Fq_rawMMul1 = Fq_baseline::Fq_rawMMul1;
+    Fq_rawToMontgomery = Fq_baseline::Fq_rawToMontgomery;
+    Fq_rawFromMontgomery = Fq_baseline::Fq_rawFromMontgomery;
+    Fq_rawMulWide = Fq_baseline::Fq_rawMulWide;
+    Fq_rawMReduceWide = Fq_baseline::Fq_rawMReduceWide;
+    return "x86-64";
+}
+
+static const char *Fq_selectKernels() {
+    static const char *name = Fq_pickKernels();
+    return name;
+}
+
+const char *Fq_rawKernel() {
+    return Fq_selectKernels();
+}
+
+#elif defined(USE_ASM) && defined(ARCH_ARM64)
+
+const char *Fq_rawKernel() {
+    return "arm64";
+}
+
+#else
+
+const char *Fq_rawKernel() {
+    return "generic";
+}
+
+#endif
+
 void Fq_toMpz(mpz_t r, PFqElement pE) {
     FqElement tmp;
     Fq_toNormal(&tmp, pE);
@@ -255,6 +352,48 @@ void RawFq::div(Element &r, const Element &a, const Element &b) {
     mul(r, a, tmp);
 }
 
+// Montgomery's trick: inverts n elements with a single inversion and 3n
+// multiplications. Zeros are skipped and map to zero. r and a must not
+// overlap.
+void RawFq::batchInverse(Element *r, const Element *a, uint64_t n) {
+    if (n == 0) return;
+    Element acc;
+    copy(acc, fOne);
+    for (uint64_t i=0; i<n; i++) {
+        copy(r[i], acc);
+        if (!isZero(a[i])) mul(acc, acc, a[i]);
+    }
+    inv(acc, acc);
+    for (uint64_t i=n; i-- > 0;) {
+        if (isZero(a[i])) {
+            copy(r[i], fZero);
+            continue;
+        }
+        mul(r[i], r[i], acc);
+        mul(acc, acc, a[i]);
+    }
+}
+
+void RawFq::addWide(WideElement &r, const WideElement &a, const WideElement &b) {
+    mpn_add_n(r.v, a.v, b.v, Fq_N64*2);
+}
+
+void RawFq::subWide(WideElement &r, const WideElement &a, const WideElement &b) {
+    if (mpn_sub_n(r.v, a.v, b.v, Fq_N64*2)) {
+        mpn_add_n(r.v + Fq_N64, r.v + Fq_N64, Fq_q.longVal, Fq_N64);
+    }
+}
+
+void RawFq::addLazy(Element &r, const Element &a, const Element &b) {
+    mpn_add_n(r.v, a.v, b.v, Fq_N64);
+}
+
+void RawFq::subLazy(Element &r, const Element &a, const Element &b) {
+    Element tmp;
+    mpn_sub_n(tmp.v, Fq_q.longVal, b.v, Fq_N64);
+    mpn_add_n(r.v, a.v, tmp.v, Fq_N64);
+}
+
 #define BIT_IS_SET(s, p) (s[p>>3] & (1 << (p & 0x7)))
 void RawFq::exp(Element &r, const Element &base, uint8_t* scalar, unsigned int scalarSize) {
     bool oneFound = false;
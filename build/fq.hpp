@@ -54,11 +54,38 @@ extern "C" void Fq_rawSwap(FqRawElement pRawResult, FqRawElement pRawA);
 extern "C" void Fq_rawAdd(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
 extern "C" void Fq_rawSub(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
 extern "C" void Fq_rawNeg(FqRawElement pRawResult, const FqRawElement pRawA);
-extern "C" void Fq_rawMMul(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
-extern "C" void Fq_rawMSquare(FqRawElement pRawResult, const FqRawElement pRawA);
-extern "C" void Fq_rawMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
-extern "C" void Fq_rawToMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
-extern "C" void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
+extern "C" void Fq_rawMMulAdx(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+extern "C" void Fq_rawMSquareAdx(FqRawElement pRawResult, const FqRawElement pRawA);
+extern "C" void Fq_rawMMul1Adx(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
+extern "C" void Fq_rawToMontgomeryAdx(FqRawElement pRawResult, const FqRawElement &pRawA);
+extern "C" void Fq_rawFromMontgomeryAdx(FqRawElement pRawResult, const FqRawElement &pRawA);
+extern "C" void Fq_rawMulWideAdx(FqRawWideElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+extern "C" void Fq_rawMReduceWideAdx(FqRawElement pRawResult, const FqRawWideElement pRawA);
+
+// The kernels above need BMI2 and ADX. Calls go through these pointers,
+// which the first call sets to them, or to the baseline x86-64 versions
+// from fq_raw_generic.cpp on hosts without.
+extern void (*Fq_rawMMul)(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+extern void (*Fq_rawMSquare)(FqRawElement pRawResult, const FqRawElement pRawA);
+extern void (*Fq_rawMMul1)(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
+extern void (*Fq_rawToMontgomery)(FqRawElement pRawResult, const FqRawElement &pRawA);
+extern void (*Fq_rawFromMontgomery)(FqRawElement pRawResult, const FqRawElement &pRawA);
+extern void (*Fq_rawMulWide)(FqRawWideElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+extern void (*Fq_rawMReduceWide)(FqRawElement pRawResult, const FqRawWideElement pRawA);
+
+// The baseline versions, also callable directly to compare them with the
+// kernels above.
+namespace Fq_baseline
+{
+void Fq_rawMMul(FqRawElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+void Fq_rawMSquare(FqRawElement pRawResult, const FqRawElement pRawA);
+void Fq_rawMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
+void Fq_rawToMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
+void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
+void Fq_rawMulWide(FqRawWideElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+void Fq_rawMReduceWide(FqRawElement pRawResult, const FqRawWideElement pRawA);
+}
+
 extern "C" int Fq_rawIsEq(const FqRawElement pRawA, const FqRawElement pRawB);
 extern "C" int Fq_rawIsZero(const FqRawElement pRawB);
 extern "C" void Fq_rawShl(FqRawElement r, FqRawElement a, uint64_t b);
@@ -107,6 +134,8 @@ extern "C" void Fq_rawMMul(FqRawElement pRawResult, const FqRawElement pRawA, co
 extern "C" void Fq_rawMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
            void Fq_rawToMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
 extern "C" void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
+           void Fq_rawMulWide(FqRawWideElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+           void Fq_rawMReduceWide(FqRawElement pRawResult, const FqRawWideElement pRawA);
 extern "C" int  Fq_rawIsEq(const FqRawElement pRawA, const FqRawElement pRawB);
 extern "C" int  Fq_rawIsZero(const FqRawElement pRawB);
            void Fq_rawZero(FqRawElement pRawResult);
@@ -171,6 +200,8 @@ void Fq_rawMSquare(FqRawElement pRawResult, const FqRawElement pRawA);
 void Fq_rawMMul1(FqRawElement pRawResult, const FqRawElement pRawA, uint64_t pRawB);
 void Fq_rawToMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
 void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA);
+void Fq_rawMulWide(FqRawWideElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB);
+void Fq_rawMReduceWide(FqRawElement pRawResult, const FqRawWideElement pRawA);
 int Fq_rawIsEq(const FqRawElement pRawA, const FqRawElement pRawB);
 int Fq_rawIsZero(const FqRawElement pRawB);
 void Fq_rawZero(FqRawElement pRawResult);
@@ -193,6 +224,9 @@ void Fq_longErr();
 
 #endif
 
+// Name of the raw kernels in use, for the logs.
+const char *Fq_rawKernel();
+
 // Pending functions to convert
 
 void Fq_str2element(PFqElement pE, char const*s, uint base);
@@ -214,6 +248,10 @@ public:
         FqRawElement v;
     };
 
+    struct WideElement {
+        FqRawWideElement v;
+    };
+
 private:
     Element fZero;
     Element fOne;
@@ -259,8 +297,20 @@ public:
     void inline square(Element &r, const Element &a) { Fq_rawMSquare(r.v, a.v); };
     void inv(Element &r, const Element &a);
     void div(Element &r, const Element &a, const Element &b);
+    void batchInverse(Element *r, const Element *a, uint64_t n);
     void exp(Element &r, const Element &base, uint8_t* scalar, unsigned int scalarSize);
 
+    // Lazy reduction: full products, summed unreduced and reduced once. The
+    // value reduced must be below q * 2^256.
+    void inline mulWide(WideElement &r, const Element &a, const Element &b) { Fq_rawMulWide(r.v, a.v, b.v); };
+    void inline reduceWide(Element &r, const WideElement &a) { Fq_rawMReduceWide(r.v, a.v); };
+    void addWide(WideElement &r, const WideElement &a, const WideElement &b);
+    // a - b, plus q * 2^256 if negative.
+    void subWide(WideElement &r, const WideElement &a, const WideElement &b);
+    // a + b and a - b + q, left below 2q.
+    void addLazy(Element &r, const Element &a, const Element &b);
+    void subLazy(Element &r, const Element &a, const Element &b);
+
     void inline toMontgomery(Element &r, const Element &a) { Fq_rawToMontgomery(r.v, a.v); };
     void inline fromMontgomery(Element &r, const Element &a) { Fq_rawFromMontgomery(r.v, a.v); };
     int inline eq(const Element &a, const Element &b) { return Fq_rawIsEq(a.v, b.v); };
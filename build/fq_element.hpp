@@ -11,6 +11,7 @@
 #define Fq_LONGMONTGOMERY  0xC0000000
 
 typedef uint64_t FqRawElement[Fq_N64];
+typedef uint64_t FqRawWideElement[Fq_N64*2];
 
 typedef struct __attribute__((__packed__)) {
     int32_t shortVal;
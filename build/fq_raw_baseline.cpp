@@ -0,0 +1,10 @@
+#include "fq_element.hpp"
+#include <gmp.h>
+#include <cstring>
+
+// fq_raw_generic.cpp in a namespace of its own, for the baseline x86-64
+// kernels that fq.cpp falls back to on hosts without BMI2 and ADX.
+namespace Fq_baseline
+{
+#include "fq_raw_generic.cpp"
+}
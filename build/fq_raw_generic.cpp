@@ -231,6 +231,35 @@ void Fq_rawFromMontgomery(FqRawElement pRawResult, const FqRawElement &pRawA)
     }
 }
 
+void Fq_rawMulWide(FqRawWideElement pRawResult, const FqRawElement pRawA, const FqRawElement pRawB)
+{
+    mpn_mul_n(pRawResult, pRawA, pRawB, Fq_N64);
+}
+
+// Montgomery reduction of a double width value below q * 2^256
+void Fq_rawMReduceWide(FqRawElement pRawResult, const FqRawWideElement pRawA)
+{
+    const uint64_t  *mq = Fq_rawq;
+
+    uint64_t  product[Fq_N64*2+1];
+
+    mpn_copyi(product, pRawA, Fq_N64*2); product[Fq_N64*2] = 0;
+
+    for (int i = 0; i < Fq_N64; i++)
+    {
+        uint64_t np0 = Fq_np * product[i];
+        uint64_t carry = mpn_addmul_1(product+i, mq, Fq_N64, np0);
+        mpn_add_1(product+i+Fq_N64, product+i+Fq_N64, Fq_N64+1-i, carry);
+    }
+
+    mpn_copyi(pRawResult,  product+Fq_N64, Fq_N64);
+
+    if (product[Fq_N64*2] || mpn_cmp(pRawResult, mq, Fq_N64) >= 0)
+    {
+        mpn_sub_n(pRawResult, pRawResult, mq, Fq_N64);
+    }
+}
+
 int Fq_rawIsZero(const FqRawElement rawA)
 {
     return mpn_zero_p(rawA, Fq_N64) ? 1 : 0;
@@ -36,11 +36,11 @@
         global Fr_rawAdd
         global Fr_rawSub
         global Fr_rawNeg
-        global Fr_rawMMul
-        global Fr_rawMMul1
-        global Fr_rawMSquare
-        global Fr_rawToMontgomery
-        global Fr_rawFromMontgomery
+        global Fr_rawMMulAdx
+        global Fr_rawMMul1Adx
+        global Fr_rawMSquareAdx
+        global Fr_rawToMontgomeryAdx
+        global Fr_rawFromMontgomeryAdx
         global Fr_rawIsEq
         global Fr_rawIsZero
         global Fr_rawShr
@@ -369,7 +369,7 @@ Fr_longErr:
 
 
 
-Fr_rawMMul:
+Fr_rawMMulAdx:
     push r15
     push r14
     push r13
@@ -537,7 +537,7 @@ Fr_rawMMul_done:
     pop r14
     pop r15
     ret
-Fr_rawMSquare:
+Fr_rawMSquareAdx:
     push r15
     push r14
     push r13
@@ -705,7 +705,7 @@ Fr_rawMSquare_done:
     pop r14
     pop r15
     ret
-Fr_rawMMul1:
+Fr_rawMMul1Adx:
     push r15
     push r14
     push r13
@@ -828,7 +828,7 @@ Fr_rawMMul1_done:
     pop r14
     pop r15
     ret
-Fr_rawFromMontgomery:
+Fr_rawFromMontgomeryAdx:
     push r15
     push r14
     push r13
@@ -954,10 +954,10 @@ Fr_rawFromMontgomery_done:
 ;   rdi <= Pointer destination element
 ;   rsi <= Pointer to src element
 ;;;;;;;;;;;;;;;;;;;;
-Fr_rawToMontgomery:
+Fr_rawToMontgomeryAdx:
     push    rdx
     lea     rdx, [R2]
-    call    Fr_rawMMul
+    call    Fr_rawMMulAdx
     pop     rdx
     ret
 
@@ -985,7 +985,7 @@ toMontgomeryShort:
     cmp     rdx, 0
     js      negMontgomeryShort
 posMontgomeryShort:
-    call    Fr_rawMMul1
+    call    Fr_rawMMul1Adx
     sub     rdi, 8
             mov r11b, 0x40
         shl r11d, 24
@@ -994,7 +994,7 @@ posMontgomeryShort:
 
 negMontgomeryShort:
     neg     rdx              ; Do the multiplication positive and then negate the result.
-    call    Fr_rawMMul1
+    call    Fr_rawMMul1Adx
     mov     rsi, rdi
     call    rawNegL
     sub     rdi, 8
@@ -1009,7 +1009,7 @@ toMontgomeryLong:
     add     rdi, 8
     add     rsi, 8
     lea     rdx, [R2]
-    call    Fr_rawMMul
+    call    Fr_rawMMulAdx
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0xC0
@@ -1041,7 +1041,7 @@ Fr_toNormal:
 toNormalLong:
     add     rdi, 8
     add     rsi, 8
-    call    Fr_rawFromMontgomery
+    call    Fr_rawFromMontgomeryAdx
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0x80
@@ -1074,7 +1074,7 @@ Fr_toLongNormal:
 toLongNormal_fromMontgomery:
     add     rdi, 8
     add     rsi, 8
-    call    Fr_rawFromMontgomery
+    call    Fr_rawFromMontgomeryAdx
     sub     rsi, 8
     sub     rdi, 8
             mov r11b, 0x80
@@ -2341,7 +2341,7 @@ square_l1n:
 
         add rdi, 8
         add rsi, 8
-        call Fr_rawMSquare
+        call Fr_rawMSquareAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2350,7 +2350,7 @@ square_l1n:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         pop rsi
 
@@ -2363,7 +2363,7 @@ square_l1m:
 
         add rdi, 8
         add rsi, 8
-        call Fr_rawMSquare
+        call Fr_rawMSquareAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2435,7 +2435,7 @@ mul_l1ns2n:
         
         jns tmp_5
         neg rdx
-        call Fr_rawMMul1
+        call Fr_rawMMul1Adx
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2443,7 +2443,7 @@ mul_l1ns2n:
         
         jmp tmp_6
 tmp_5:
-        call Fr_rawMMul1
+        call Fr_rawMMul1Adx
         sub rdi, 8
         pop rsi
 tmp_6:
@@ -2454,7 +2454,7 @@ tmp_6:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         pop rsi
 
@@ -2469,7 +2469,7 @@ mul_l1ns2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2492,7 +2492,7 @@ mul_l1ms2n:
         
         jns tmp_7
         neg rdx
-        call Fr_rawMMul1
+        call Fr_rawMMul1Adx
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2500,7 +2500,7 @@ mul_l1ms2n:
         
         jmp tmp_8
 tmp_7:
-        call Fr_rawMMul1
+        call Fr_rawMMul1Adx
         sub rdi, 8
         pop rsi
 tmp_8:
@@ -2516,7 +2516,7 @@ mul_l1ms2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2543,7 +2543,7 @@ mul_s1nl2n:
         
         jns tmp_9
         neg rdx
-        call Fr_rawMMul1
+        call Fr_rawMMul1Adx
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2551,7 +2551,7 @@ mul_s1nl2n:
         
         jmp tmp_10
 tmp_9:
-        call Fr_rawMMul1
+        call Fr_rawMMul1Adx
         sub rdi, 8
         pop rsi
 tmp_10:
@@ -2562,7 +2562,7 @@ tmp_10:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         pop rsi
 
@@ -2581,7 +2581,7 @@ mul_s1nl2m:
         
         jns tmp_11
         neg rdx
-        call Fr_rawMMul1
+        call Fr_rawMMul1Adx
         mov rsi, rdi
         call rawNegL
         sub rdi, 8
@@ -2589,7 +2589,7 @@ mul_s1nl2m:
         
         jmp tmp_12
 tmp_11:
-        call Fr_rawMMul1
+        call Fr_rawMMul1Adx
         sub rdi, 8
         pop rsi
 tmp_12:
@@ -2608,7 +2608,7 @@ mul_s1ml2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2622,7 +2622,7 @@ mul_s1ml2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2643,7 +2643,7 @@ mul_l1nl2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2652,7 +2652,7 @@ mul_l1nl2n:
         add rdi, 8
         mov rsi, rdi
         lea rdx, [R3]
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         pop rsi
 
@@ -2666,7 +2666,7 @@ mul_l1nl2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2683,7 +2683,7 @@ mul_l1ml2n:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -2697,7 +2697,7 @@ mul_l1ml2m:
         add rdi, 8
         add rsi, 8
         add rdx, 8
-        call Fr_rawMMul
+        call Fr_rawMMulAdx
         sub rdi, 8
         sub rsi, 8
 
@@ -13,6 +13,87 @@ static mpz_t mask;
 static size_t nBits;
 static bool initialized = false;
 
+#if defined(USE_ASM) && defined(ARCH_X86_64)
+
+#include <cpuid.h>
+
+static const char *Fr_selectKernels();
+
+// The pointers start at resolvers that select the kernels first, so that
+// calls from static initializers of other files are safe too.
+static void Fr_resolveMMul(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB) {
+    Fr_selectKernels();
+    Fr_rawMMul(pRawResult, pRawA, pRawB);
+}
+
+static void Fr_resolveMSquare(FrRawElement pRawResult, const FrRawElement pRawA) {
+    Fr_selectKernels();
+    Fr_rawMSquare(pRawResult, pRawA);
+}
+
+static void Fr_resolveMMul1(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB) {
+    Fr_selectKernels();
+    Fr_rawMMul1(pRawResult, pRawA, pRawB);
+}
+
+static void Fr_resolveToMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA) {
+    Fr_selectKernels();
+    Fr_rawToMontgomery(pRawResult, pRawA);
+}
+
+static void Fr_resolveFromMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA) {
+    Fr_selectKernels();
+    Fr_rawFromMontgomery(pRawResult, pRawA);
+}
+
+void (*Fr_rawMMul)(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB) = Fr_resolveMMul;
+void (*Fr_rawMSquare)(FrRawElement pRawResult, const FrRawElement pRawA) = Fr_resolveMSquare;
+void (*Fr_rawMMul1)(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB) = Fr_resolveMMul1;
+void (*Fr_rawToMontgomery)(FrRawElement pRawResult, const FrRawElement &pRawA) = Fr_resolveToMontgomery;
+void (*Fr_rawFromMontgomery)(FrRawElement pRawResult, const FrRawElement &pRawA) = Fr_resolveFromMontgomery;
+
+static const char *Fr_pickKernels() {
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx);
+    if ((ebx & bit_BMI2) && (ebx & bit_ADX)) {
+        Fr_rawMMul = Fr_rawMMulAdx;
+        Fr_rawMSquare = Fr_rawMSquareAdx;
+        Fr_rawMMul1 = Fr_rawMMul1Adx;
+        Fr_rawToMontgomery = Fr_rawToMontgomeryAdx;
+        Fr_rawFromMontgomery = Fr_rawFromMontgomeryAdx;
+        return "bmi2/adx";
+    }
+    Fr_rawMMul = Fr_baseline::Fr_rawMMul;
+    Fr_rawMSquare = Fr_baseline::Fr_rawMSquare;
+    Fr_rawMMul1 = Fr_baseline::Fr_rawMMul1;
+    Fr_rawToMontgomery = Fr_baseline::Fr_rawToMontgomery;
+    Fr_rawFromMontgomery = Fr_baseline::Fr_rawFromMontgomery;
+    return "x86-64";
+}
+
+static const char *Fr_selectKernels() {
+    static const char *name = Fr_pickKernels();
+    return name;
+}
+
+const char *Fr_rawKernel() {
+    return Fr_selectKernels();
+}
+
+#elif defined(USE_ASM) && defined(ARCH_ARM64)
+
+const char *Fr_rawKernel() {
+    return "arm64";
+}
+
+#else
+
+const char *Fr_rawKernel() {
+    return "generic";
+}
+
+#endif
+
 void Fr_toMpz(mpz_t r, PFrElement pE) {
     FrElement tmp;
     Fr_toNormal(&tmp, pE);
@@ -255,6 +336,28 @@ void RawFr::div(Element &r, const Element &a, const Element &b) {
     mul(r, a, tmp);
 }
 
+// Montgomery's trick: inverts n elements with a single inversion and 3n
+// multiplications. Zeros are skipped and map to zero. r and a must not
+// overlap.
+void RawFr::batchInverse(Element *r, const Element *a, uint64_t n) {
+    if (n == 0) return;
+    Element acc;
+    copy(acc, fOne);
+    for (uint64_t i=0; i<n; i++) {
+        copy(r[i], acc);
+        if (!isZero(a[i])) mul(acc, acc, a[i]);
+    }
+    inv(acc, acc);
+    for (uint64_t i=n; i-- > 0;) {
+        if (isZero(a[i])) {
+            copy(r[i], fZero);
+            continue;
+        }
+        mul(r[i], r[i], acc);
+        mul(acc, acc, a[i]);
+    }
+}
+
 #define BIT_IS_SET(s, p) (s[p>>3] & (1 << (p & 0x7)))
 void RawFr::exp(Element &r, const Element &base, uint8_t* scalar, unsigned int scalarSize) {
     bool oneFound = false;
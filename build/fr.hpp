@@ -54,11 +54,32 @@ extern "C" void Fr_rawSwap(FrRawElement pRawResult, FrRawElement pRawA);
 extern "C" void Fr_rawAdd(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
 extern "C" void Fr_rawSub(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
 extern "C" void Fr_rawNeg(FrRawElement pRawResult, const FrRawElement pRawA);
-extern "C" void Fr_rawMMul(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
-extern "C" void Fr_rawMSquare(FrRawElement pRawResult, const FrRawElement pRawA);
-extern "C" void Fr_rawMMul1(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB);
-extern "C" void Fr_rawToMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA);
-extern "C" void Fr_rawFromMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA);
+extern "C" void Fr_rawMMulAdx(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
+extern "C" void Fr_rawMSquareAdx(FrRawElement pRawResult, const FrRawElement pRawA);
+extern "C" void Fr_rawMMul1Adx(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB);
+extern "C" void Fr_rawToMontgomeryAdx(FrRawElement pRawResult, const FrRawElement &pRawA);
+extern "C" void Fr_rawFromMontgomeryAdx(FrRawElement pRawResult, const FrRawElement &pRawA);
+
+// The kernels above need BMI2 and ADX. Calls go through these pointers,
+// which the first call sets to them, or to the baseline x86-64 versions
+// from fr_raw_generic.cpp on hosts without.
+extern void (*Fr_rawMMul)(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
+extern void (*Fr_rawMSquare)(FrRawElement pRawResult, const FrRawElement pRawA);
+extern void (*Fr_rawMMul1)(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB);
+extern void (*Fr_rawToMontgomery)(FrRawElement pRawResult, const FrRawElement &pRawA);
+extern void (*Fr_rawFromMontgomery)(FrRawElement pRawResult, const FrRawElement &pRawA);
+
+// The baseline versions, also callable directly to compare them with the
+// kernels above.
+namespace Fr_baseline
+{
+void Fr_rawMMul(FrRawElement pRawResult, const FrRawElement pRawA, const FrRawElement pRawB);
+void Fr_rawMSquare(FrRawElement pRawResult, const FrRawElement pRawA);
+void Fr_rawMMul1(FrRawElement pRawResult, const FrRawElement pRawA, uint64_t pRawB);
+void Fr_rawToMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA);
+void Fr_rawFromMontgomery(FrRawElement pRawResult, const FrRawElement &pRawA);
+}
+
 extern "C" int Fr_rawIsEq(const FrRawElement pRawA, const FrRawElement pRawB);
 extern "C" int Fr_rawIsZero(const FrRawElement pRawB);
 extern "C" void Fr_rawShl(FrRawElement r, FrRawElement a, uint64_t b);
@@ -193,6 +214,9 @@ void Fr_longErr();
 
 #endif
 
+// Name of the raw kernels in use, for the logs.
+const char *Fr_rawKernel();
+
 // Pending functions to convert
 
 void Fr_str2element(PFrElement pE, char const*s, uint base);
@@ -259,6 +283,7 @@ public:
     void inline square(Element &r, const Element &a) { Fr_rawMSquare(r.v, a.v); };
     void inv(Element &r, const Element &a);
     void div(Element &r, const Element &a, const Element &b);
+    void batchInverse(Element *r, const Element *a, uint64_t n);
     void exp(Element &r, const Element &base, uint8_t* scalar, unsigned int scalarSize);
 
     void inline toMontgomery(Element &r, const Element &a) { Fr_rawToMontgomery(r.v, a.v); };
@@ -0,0 +1,10 @@
+#include "fr_element.hpp"
+#include <gmp.h>
+#include <cstring>
+
+// fr_raw_generic.cpp in a namespace of its own, for the baseline x86-64
+// kernels that fr.cpp falls back to on hosts without BMI2 and ADX.
+namespace Fr_baseline
+{
+#include "fr_raw_generic.cpp"
+}
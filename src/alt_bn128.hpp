@@ -5,6 +5,7 @@
 #include "f2field.hpp"
 #include "fq.hpp"
 #include "fr.hpp"
+#include "mont_field.hpp"
 #include <string>
 namespace AltBn128
 {
@@ -17,6 +18,23 @@ typedef Curve<RawFq>::PointAffine          G1PointAffine;
 typedef Curve<F2Field<RawFq>>::Point       G2Point;
 typedef Curve<F2Field<RawFq>>::PointAffine G2PointAffine;
 
+// Moduli of the header only MontField backend, an inlinable alternative to
+// the generated RawFq and RawFr.
+struct FqParams
+{
+    static constexpr std::uint64_t q[4] = {
+        0x3c208c16d87cfd47, 0x97816a916871ca8d, 0xb85045b68181585d,
+        0x30644e72e131a029};
+};
+struct FrParams
+{
+    static constexpr std::uint64_t q[4] = {
+        0x43e1f593f0000001, 0x2833e84879b97091, 0xb85045b68181585d,
+        0x30644e72e131a029};
+};
+typedef MontField<FqParams> MontFq;
+typedef MontField<FrParams> MontFr;
+
 extern RawFq                 F1;
 extern F2Field<RawFq>        F2;
 extern RawFr                 Fr;
@@ -51,6 +69,14 @@ public:
              // clang-format on
           )
     {
+        // beta for G2 is the square of the one for G1, so that both act as
+        // multiplication by the same lambda.
+        g1.setEndomorphism(
+            "2203960485148121921418603742825762020974279258880205651966",
+            bn254GLVParams);
+        g2.setEndomorphism("2188824287183927522004244526010915316727770741447"
+                           "2061641714758635765020556616, 0",
+                           bn254GLVParams);
     }
 
     typedef F1::Element     F1Element;
@@ -0,0 +1,40 @@
+#ifndef BATCH_INVERSE_HPP
+#define BATCH_INVERSE_HPP
+
+#include <tbb/parallel_for.h>
+
+#include <algorithm>
+#include <cstdint>
+
+// Elements per task of parallelBatchInverse. Each chunk pays for one field
+// inversion, a few hundred multiplications, so chunks must be well above
+// that to amortize it.
+#ifndef BATCH_INVERSE_CHUNK
+#define BATCH_INVERSE_CHUNK 4096
+#endif
+
+// Field::batchInverse over chunks of BATCH_INVERSE_CHUNK elements run in
+// parallel, one inversion per chunk. Zeros map to zero. r and a must not
+// overlap.
+template <typename Field>
+void parallelBatchInverse(Field& f, typename Field::Element* r,
+                          const typename Field::Element* a, std::uint64_t n)
+{
+    std::uint64_t nChunks = (n + BATCH_INVERSE_CHUNK - 1) / BATCH_INVERSE_CHUNK;
+    if (nChunks <= 1)
+    {
+        f.batchInverse(r, a, n);
+        return;
+    }
+
+    tbb::parallel_for(std::uint64_t(0), nChunks,
+                      [&](std::uint64_t c)
+                      {
+                          std::uint64_t begin = c * BATCH_INVERSE_CHUNK;
+                          std::uint64_t len   = std::min<std::uint64_t>(
+                              BATCH_INVERSE_CHUNK, n - begin);
+                          f.batchInverse(r + begin, a + begin, len);
+                      });
+}
+
+#endif // BATCH_INVERSE_HPP
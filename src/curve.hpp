@@ -2,8 +2,11 @@
 
 #include <sstream>
 #include <string>
+#include <vector>
 
+#include "batch_inverse.hpp"
 #include "exp.hpp"
+#include "glv.hpp"
 #include "multiexp.hpp"
 
 template <typename BaseField>
@@ -14,6 +17,8 @@ class Curve
                 typename BaseField::Element& ab);
 
 public:
+    typedef BaseField Field;
+
     struct Point
     {
         typename BaseField::Element x;
@@ -50,6 +55,8 @@ private:
     Point                       fzero;
     PointAffine                 foneAffine;
     PointAffine                 fzeroAffine;
+    typename BaseField::Element fbeta;
+    const GLVParams*            glvParams;
 
 public:
 #ifdef COUNT_OPS
@@ -78,6 +85,22 @@ public:
     Point&                       zero() { return fzero; };
     PointAffine&                 zeroAffine() { return fzeroAffine; };
 
+    // Endomorphism (x, y) -> (beta * x, y) used by the GLV method, beta must
+    // be the cube root of unity for which it acts on the prime order subgroup
+    // as the multiplication by the lambda of params.
+    void setEndomorphism(std::string betas, const GLVParams& params)
+    {
+        F.fromString(fbeta, betas);
+        glvParams = &params;
+    }
+    bool             hasEndomorphism() { return glvParams != nullptr; }
+    const GLVParams& glv() { return *glvParams; }
+    void             endomorphism(PointAffine& r, PointAffine& a)
+    {
+        F.mul(r.x, fbeta, a.x);
+        F.copy(r.y, a.y);
+    }
+
     void add(Point& p3, Point& p1, Point& p2);
     void add(Point& p3, Point& p1, PointAffine& p2);
     void add(Point& p3, PointAffine& p1, PointAffine& p2);
@@ -156,6 +179,15 @@ public:
         add(p3, p1, tmp);
     }
 
+    // Affine addition with the field inversion split out, so that the
+    // inversions of many independent additions can be shared through
+    // BaseField::batchInverse. The points must not be zero.
+    void addAffineDenominator(typename BaseField::Element& d, PointAffine& p1,
+                              PointAffine& p2);
+    void addAffineWithInverse(PointAffine& p3, PointAffine& p1,
+                              PointAffine& p2,
+                              typename BaseField::Element& dInv);
+
     void dbl(Point& r, Point& a);
     void dbl(Point& r, PointAffine& a);
     void dbl(PointAffine& r, Point& a)
@@ -191,6 +223,10 @@ public:
     void copy(PointAffine& r, Point& a);
     void copy(PointAffine& r, PointAffine& a);
 
+    // Affine copies of n points, the inversions shared through
+    // parallelBatchInverse. Zero points map to zeroAffine().
+    void batchNormalize(PointAffine* r, Point* p, uint64_t n);
+
     void mulByScalar(Point& r, Point& base, uint8_t* scalar,
                      unsigned int scalarSize)
     {
@@ -205,11 +241,14 @@ public:
             *this, r, base, scalar, scalarSize);
     }
 
+    // The multiexps take their scratch memory from ws when given one, and
+    // keep their buckets within its memoryBudget.
     void multiMulByScalar(Point& r, PointAffine* bases, uint8_t* scalars,
                           unsigned int scalarSize, unsigned int n,
-                          unsigned int nThreads = 0)
+                          unsigned int nThreads = 0,
+                          MultiexpWorkspace* ws = nullptr)
     {
-        ParallelMultiexp<Curve<BaseField>> pm(*this);
+        ParallelMultiexp<Curve<BaseField>> pm(*this, ws);
         pm.multiexp(r, bases, scalars, scalarSize, n, nThreads);
     }
     void multiMulByScalar(Point& r, PointAffine* bases, uint8_t* scalars,
@@ -220,6 +259,64 @@ public:
         pm.multiexp(r, bases, scalars, scalarSize, n, nx, x, nThreads);
     }
 
+    // Precomputes up to maxCopies shifted copies of the bases for
+    // multiMulByScalar with a FixedBaseTable, see FixedBaseTable.
+    void precomputeBases(FixedBaseTable<Curve<BaseField>>& table,
+                         PointAffine* bases, unsigned int scalarSize,
+                         unsigned int n, unsigned int maxCopies)
+    {
+        ParallelMultiexp<Curve<BaseField>> pm(*this);
+        pm.precompute(table, bases, n, scalarSize, maxCopies);
+    }
+    void multiMulByScalar(Point& r, FixedBaseTable<Curve<BaseField>>& table,
+                          uint8_t* scalars, MultiexpWorkspace* ws = nullptr)
+    {
+        ParallelMultiexp<Curve<BaseField>> pm(*this, ws);
+        pm.multiexp(r, table, scalars);
+    }
+
+    // Window digits of the scalars to share between multiexps, see
+    // ScalarPlan. bitsPerChunk and minChunks match a FixedBaseTable.
+    void planScalars(ScalarPlan& plan, uint8_t* scalars,
+                     unsigned int scalarSize, unsigned int n,
+                     unsigned int bitsPerChunk = 0, unsigned int minChunks = 0,
+                     MultiexpWorkspace* ws = nullptr)
+    {
+        ParallelMultiexp<Curve<BaseField>> pm(*this, ws);
+        pm.makePlan(plan, scalars, scalarSize, n, bitsPerChunk, minChunks);
+    }
+    void multiMulByScalar(Point& r, PointAffine* bases, ScalarPlan& plan,
+                          unsigned int offset, unsigned int n,
+                          MultiexpWorkspace* ws = nullptr)
+    {
+        ParallelMultiexp<Curve<BaseField>> pm(*this, ws);
+        pm.multiexp(r, bases, plan, offset, n);
+    }
+    void multiMulByScalar(Point& r, FixedBaseTable<Curve<BaseField>>& table,
+                          ScalarPlan& plan, unsigned int offset,
+                          MultiexpWorkspace* ws = nullptr)
+    {
+        ParallelMultiexp<Curve<BaseField>> pm(*this, ws);
+        pm.multiexp(r, table, plan, offset);
+    }
+
+    // The multiexps of several plans with the same bases, which are read
+    // once for all of them. r[i] gets the one of plans[i].
+    void multiMulByScalar(Point* r, PointAffine* bases, ScalarPlan** plans,
+                          unsigned int nPlans, unsigned int offset,
+                          unsigned int n, MultiexpWorkspace* ws = nullptr)
+    {
+        ParallelMultiexp<Curve<BaseField>> pm(*this, ws);
+        pm.multiexp(r, bases, plans, nPlans, offset, n);
+    }
+    void multiMulByScalar(Point* r, FixedBaseTable<Curve<BaseField>>& table,
+                          ScalarPlan** plans, unsigned int nPlans,
+                          unsigned int offset, MultiexpWorkspace* ws = nullptr)
+    {
+        ParallelMultiexp<Curve<BaseField>> pm(*this, ws);
+        pm.multiexp(r, table, plans, nPlans, offset);
+    }
+
 #ifdef COUNT_OPS
     void resetCounters();
     void printCounters();
@@ -277,6 +374,7 @@ void Curve<BaseField>::initCurve(typename BaseField::Element& aa,
     F.copy(fzeroAffine.y, F.zero());
     F.copy(fzero.zz, F.zero());
     F.copy(fzero.zzz, F.zero());
+    glvParams = nullptr;
 
     if (F.isZero(fa))
     {
@@ -578,6 +676,76 @@ void Curve<BaseField>::add(Point& p3, PointAffine& p1, PointAffine& p2)
     F.copy(p3.zzz, PPP);
 }
 
+/*
+    L = (Y2-Y1)/(X2-X1), or (3*X1^2+a)/(2*Y1) when doubling
+    X3 = L^2-X1-X2
+    Y3 = L*(X1-X3)-Y1
+
+    The denominator is set to one when p1 == -p2 so that it can still be part
+    of a batch inversion, addAffineWithInverse then returns zero.
+*/
+template <typename BaseField>
+void Curve<BaseField>::addAffineDenominator(typename BaseField::Element& d,
+                                            PointAffine& p1, PointAffine& p2)
+{
+    if (!F.eq(p1.x, p2.x))
+    {
+        F.sub(d, p2.x, p1.x);
+    }
+    else if (F.eq(p1.y, p2.y))
+    {
+        F.add(d, p1.y, p1.y);
+    }
+    else
+    {
+        F.copy(d, F.one());
+    }
+}
+
+template <typename BaseField>
+void Curve<BaseField>::addAffineWithInverse(PointAffine& p3, PointAffine& p1,
+                                            PointAffine& p2,
+                                            typename BaseField::Element& dInv)
+{
+#ifdef COUNT_OPS
+    cntAddAffine++;
+#endif // COUNT_OPS
+
+    typename BaseField::Element L;
+    typename BaseField::Element tmp;
+
+    if (!F.eq(p1.x, p2.x))
+    {
+        F.sub(L, p2.y, p1.y);
+    }
+    else if (F.eq(p1.y, p2.y))
+    {
+        F.square(tmp, p1.x);
+        F.add(L, tmp, tmp);
+        F.add(L, L, tmp);
+        F.add(L, L, fa);
+    }
+    else
+    {
+        F.copy(p3.x, F.zero());
+        F.copy(p3.y, F.zero());
+        return;
+    }
+    F.mul(L, L, dInv);
+
+    // X3 = L^2-X1-X2
+    typename BaseField::Element X3;
+    F.square(X3, L);
+    F.sub(X3, X3, p1.x);
+    F.sub(X3, X3, p2.x);
+
+    // Y3 = L*(X1-X3)-Y1
+    F.sub(tmp, p1.x, X3);
+    F.mul(tmp, tmp, L);
+    F.sub(p3.y, tmp, p1.y);
+    F.copy(p3.x, X3);
+}
+
 /*
     https://www.hyperelliptic.org/EFD/g1p/auto-shortw-xyzz.html#addition-madd-2008-s
     U = 2*Y1
@@ -851,6 +1019,47 @@ void Curve<BaseField>::copy(PointAffine& r, PointAffine& a)
     F.copy(r.y, a.y);
 }
 
+// x / zz and y / zzz from the single inverse of zz * zzz.
+template <typename BaseField>
+void Curve<BaseField>::batchNormalize(PointAffine* r, Point* p, uint64_t n)
+{
+#ifdef COUNT_OPS
+    cntToAffine += n;
+#endif // COUNT_OPS
+    std::vector<typename BaseField::Element> dens(n);
+    std::vector<typename BaseField::Element> invs(n);
+
+    tbb::parallel_for(tbb::blocked_range<uint64_t>(0, n, BATCH_INVERSE_CHUNK),
+                      [&](auto range)
+                      {
+                          for (auto i = range.begin(); i < range.end(); ++i)
+                          {
+                              F.mul(dens[i], p[i].zz, p[i].zzz);
+                          }
+                      });
+
+    parallelBatchInverse(F, invs.data(), dens.data(), n);
+
+    tbb::parallel_for(tbb::blocked_range<uint64_t>(0, n, BATCH_INVERSE_CHUNK),
+                      [&](auto range)
+                      {
+                          typename BaseField::Element t;
+                          for (auto i = range.begin(); i < range.end(); ++i)
+                          {
+                              if (isZero(p[i]))
+                              {
+                                  F.copy(r[i].x, F.zero());
+                                  F.copy(r[i].y, F.zero());
+                                  continue;
+                              }
+                              F.mul(t, invs[i], p[i].zzz);
+                              F.mul(r[i].x, p[i].x, t);
+                              F.mul(t, invs[i], p[i].zz);
+                              F.mul(r[i].y, p[i].y, t);
+                          }
+                      });
+}
+
 template <typename BaseField>
 void Curve<BaseField>::neg(Point& r, Point& a)
 {
@@ -5,6 +5,21 @@
 
 #include <sstream>
 #include <string>
+#include <type_traits>
+#include <vector>
+
+// Base fields with the double width products of RawFq get the lazily
+// reduced mul and square.
+template <typename BaseField, typename = void>
+struct HasWideMul : std::false_type
+{
+};
+
+template <typename BaseField>
+struct HasWideMul<BaseField, std::void_t<typename BaseField::WideElement>>
+    : std::true_type
+{
+};
 
 template <typename BaseField>
 class F2Field
@@ -38,6 +53,13 @@ private:
     void mulByNr(typename BaseField::Element& r,
                  typename BaseField::Element& ab);
 
+    // Templates, so that they are only instantiated for the base fields with
+    // HasWideMul that call them.
+    template <typename B = BaseField>
+    void mulLazy(Element& r, Element& a, Element& b);
+    template <typename B = BaseField>
+    void squareLazy(Element& r, Element& a);
+
     void initField(typename BaseField::Element& anr);
 
 public:
@@ -55,6 +77,7 @@ public:
     void mul(Element& r, Element& a, Element& b);
     void square(Element& r, Element& a);
     void inv(Element& r, Element& a);
+    void batchInverse(Element* r, const Element* a, uint64_t n);
     void div(Element& r, Element& a, Element& b);
     bool isZero(Element& a);
     bool eq(Element& a, Element& b);
@@ -180,6 +203,15 @@ void F2Field<BaseField>::copy(Element& r, Element& a)
 template <typename BaseField>
 void F2Field<BaseField>::mul(Element& r, Element& e1, Element& e2)
 {
+    if constexpr (HasWideMul<BaseField>::value)
+    {
+        if (typeOfNr == nr_is_negone)
+        {
+            mulLazy(r, e1, e2);
+            return;
+        }
+    }
+
     typename BaseField::Element aa;
     F.mul(aa, e1.a, e2.a);
     typename BaseField::Element bb;
@@ -202,6 +234,15 @@ void F2Field<BaseField>::mul(Element& r, Element& e1, Element& e2)
 template <typename BaseField>
 void F2Field<BaseField>::square(Element& r, Element& e1)
 {
+    if constexpr (HasWideMul<BaseField>::value)
+    {
+        if (typeOfNr == nr_is_negone)
+        {
+            squareLazy(r, e1);
+            return;
+        }
+    }
+
     typename BaseField::Element ab;
     typename BaseField::Element tmp1, tmp2;
 
@@ -233,6 +274,47 @@ void F2Field<BaseField>::square(Element& r, Element& e1)
     }
 }
 
+// nr = -1: a0 b0 - a1 b1 and (a0 + a1)(b0 + b1) - a0 b0 - a1 b1 taken on
+// the full products, two reductions instead of three.
+template <typename BaseField>
+template <typename B>
+void F2Field<BaseField>::mulLazy(Element& r, Element& e1, Element& e2)
+{
+    typename BaseField::Element sum1, sum2;
+    F.addLazy(sum1, e1.a, e1.b);
+    F.addLazy(sum2, e2.a, e2.b);
+
+    typename BaseField::WideElement aa, bb, cc;
+    F.mulWide(aa, e1.a, e2.a);
+    F.mulWide(bb, e1.b, e2.b);
+    F.mulWide(cc, sum1, sum2);
+
+    F.subWide(cc, cc, aa);
+    F.subWide(cc, cc, bb);
+    F.subWide(aa, aa, bb);
+
+    F.reduceWide(r.a, aa);
+    F.reduceWide(r.b, cc);
+}
+
+// nr = -1: (a0 + a1)(a0 - a1) and 2 a0 a1.
+template <typename BaseField>
+template <typename B>
+void F2Field<BaseField>::squareLazy(Element& r, Element& e1)
+{
+    typename BaseField::Element sum, diff;
+    F.addLazy(sum, e1.a, e1.b);
+    F.subLazy(diff, e1.a, e1.b);
+
+    typename BaseField::WideElement aa, ab;
+    F.mulWide(aa, sum, diff);
+    F.mulWide(ab, e1.a, e1.b);
+    F.addWide(ab, ab, ab);
+
+    F.reduceWide(r.a, aa);
+    F.reduceWide(r.b, ab);
+}
+
 template <typename BaseField>
 void F2Field<BaseField>::inv(Element& r, Element& e1)
 {
@@ -247,6 +329,46 @@ void F2Field<BaseField>::inv(Element& r, Element& e1)
     F.neg(r.b, r.b);
 }
 
+// Inverts n elements with a single base field inversion, Montgomery's
+// trick on the norms a^2 - nr*b^2. Serial and without allocations, r holds
+// the norms and their prefix products meanwhile, so that it can run inside
+// the tasks of a multiexp; parallelBatchInverse splits large runs. Zeros
+// map to zero. r and e must not overlap.
+template <typename BaseField>
+void F2Field<BaseField>::batchInverse(Element* r, const Element* e,
+                                      uint64_t n)
+{
+    if (n == 0)
+        return;
+
+    typename BaseField::Element acc, t0, t1;
+    F.copy(acc, F.one());
+    for (uint64_t i = 0; i < n; i++)
+    {
+        F.square(t0, e[i].a);
+        F.square(t1, e[i].b);
+        mulByNr(t1, t1);
+        F.sub(r[i].b, t0, t1);
+        F.copy(r[i].a, acc);
+        if (!F.isZero(r[i].b))
+            F.mul(acc, acc, r[i].b);
+    }
+    F.inv(acc, acc);
+    for (uint64_t i = n; i-- > 0;)
+    {
+        if (F.isZero(r[i].b))
+        {
+            F.copy(r[i].a, F.zero());
+            continue;
+        }
+        F.mul(t0, r[i].a, acc);
+        F.mul(acc, acc, r[i].b);
+        F.mul(r[i].a, e[i].a, t0);
+        F.mul(r[i].b, e[i].b, t0);
+        F.neg(r[i].b, r[i].b);
+    }
+}
+
 template <typename BaseField>
 void F2Field<BaseField>::div(Element& r, Element& e1, Element& e2)
 {
@@ -1,15 +1,40 @@
 #ifndef FFT_H
 #define FFT_H
 
+#include "fr_batch.hpp"
 #include "scope_guard.hpp"
 
 #include <gmp.h>
 #include <iostream>
 #include <tbb/parallel_for.h>
 
+#include <algorithm>
 #include <thread>
+#include <type_traits>
 #include <vector>
 
+// Sub transforms of up to 2^FFT_SERIAL_BLOCK_BITS points, 128KB of Fr
+// elements per vector, run all their stages serially on one task.
+#ifndef FFT_SERIAL_BLOCK_BITS
+#    define FFT_SERIAL_BLOCK_BITS 12
+#endif
+// Stages with at least FFT_BATCH_MIN_RUN butterflies per block run them
+// through the Fr batch kernels, FFT_BATCH_RUN at a time.
+#define FFT_BATCH_MIN_RUN 8
+#define FFT_BATCH_RUN 64
+// Domains of at least 2^FFT_FOUR_STEP_MIN_POW points run the four step
+// schedule of the stages, where every sub transform fits in cache, instead
+// of the recursive one, whose top stages each make a pass over the whole
+// array.
+#ifndef FFT_FOUR_STEP_MIN_POW
+#    define FFT_FOUR_STEP_MIN_POW 18
+#endif
+// Rows of the four step schedule, 2^14 points are 512KB of Fr elements.
+#define FFT_FOUR_STEP_ROW_BITS 14
+// Adjacent columns transformed together, so that every row of the group is
+// a contiguous run of memory and of twiddles.
+#define FFT_FOUR_STEP_COLUMNS 64
+
 template <typename Field>
 class FFT
 {
@@ -18,6 +43,8 @@ class FFT
 
     std::uint32_t        s;
     Element              nqr;
+    // Stage major: the 2^k roots of order 2^k are at [2^k, 2^(k+1)), so the
+    // twiddles of every stage are contiguous.
     std::vector<Element> roots;
     std::vector<Element> powTwoInv;
     // std::uint32_t        nThreads; // not used
@@ -29,6 +56,38 @@ class FFT
                       std::uint32_t s);
     void finalInverseInner(Element* a, std::uint64_t from, std::uint64_t to,
                            std::uint32_t domainPow);
+    template <typename Op>
+    void ditButterfly(Element* const* vecs, std::uint32_t count,
+                      std::uint32_t s, std::uint64_t i, Op& op);
+    template <typename Op>
+    void difButterfly(Element* const* vecs, std::uint32_t count,
+                      std::uint32_t s, std::uint64_t i, Op& op);
+    template <typename Op>
+    void ditButterfly4(Element* const* vecs, std::uint32_t count,
+                       std::uint32_t s, std::uint64_t i, Op& op);
+    template <typename Op>
+    void difButterfly4(Element* const* vecs, std::uint32_t count,
+                       std::uint32_t s, std::uint64_t i, Op& op);
+    template <bool dif, typename Op>
+    void batchButterflies(Element* const* vecs, std::uint32_t count,
+                          std::uint32_t s, bool radix4, std::uint64_t begin,
+                          std::uint64_t end, Op& op);
+    template <bool dif, typename Op>
+    void butterflies(Element* const* vecs, std::uint32_t count,
+                     std::uint32_t s, bool radix4, std::uint64_t begin,
+                     std::uint64_t end, Op& op);
+    template <bool dif, typename Op, typename Pass>
+    void passes(std::uint32_t lo, std::uint32_t hi, std::uint32_t lastStage,
+                Op& op, Pass pass);
+    template <bool dif, typename Op>
+    void block(Element* const* vecs, std::uint32_t count, std::uint64_t base,
+               std::uint32_t m, std::uint32_t lastStage, Op& op);
+    template <bool dif, typename Op>
+    void fourStep(Element* const* vecs, std::uint32_t count,
+                  std::uint32_t domainPow, Op& op);
+    template <bool dif, typename Op>
+    void transform(Element* const* vecs, std::uint32_t count,
+                   std::uint64_t n, Op op);
 
 public:
     FFT(std::uint64_t maxDomainSize, std::uint32_t _nThreads = 0);
@@ -36,10 +95,45 @@ public:
     void fft(Element* a, std::uint64_t n);
     void ifft(Element* a, std::uint64_t n);
 
+    // fft() that hands every output to op(i, a[i]) as soon as the last
+    // stage computes it, instead of another pass over the result.
+    template <typename Op>
+    void fft(Element* a, std::uint64_t n, Op op);
+
+    // Decimation in frequency ifft: takes the evaluations in natural order
+    // and leaves coefficient i at position BR(i), so that it chains into
+    // fftDit() without any permutation pass.
+    void ifftDif(Element* a, std::uint64_t n);
+    // ifftDif() followed by the shift to the coset root(domainPow + 1, 1) *
+    // <w>, coefficient i times root(domainPow + 1, i), done in its last stage.
+    void ifftCosetDif(Element* a, std::uint64_t n);
+    // Decimation in time fft of coefficients in bit reversed order, the
+    // evaluations come out in natural order.
+    void fftDit(Element* a, std::uint64_t n);
+    template <typename Op>
+    void fftDit(Element* a, std::uint64_t n, Op op);
+    // Evaluations on the coset from the evaluations on the domain.
+    void fftCoset(Element* a, std::uint64_t n);
+
+    // The same transforms over count vectors of n points at once: every
+    // butterfly loads its twiddles once for all the vectors, and the stages
+    // of all of them share one set of parallel loops. op(i) runs once every
+    // vector has its output i.
+    void fftBatch(Element* const* vecs, std::uint32_t count, std::uint64_t n);
+    void ifftCosetDifBatch(Element* const* vecs, std::uint32_t count,
+                           std::uint64_t n);
+    void fftDitBatch(Element* const* vecs, std::uint32_t count,
+                     std::uint64_t n);
+    template <typename Op>
+    void fftDitBatch(Element* const* vecs, std::uint32_t count,
+                     std::uint64_t n, Op op);
+    void fftCosetBatch(Element* const* vecs, std::uint32_t count,
+                       std::uint64_t n);
+
     std::uint32_t   log2(std::uint64_t n);
     inline Element& root(std::uint32_t domainPow, std::uint64_t idx)
     {
-        return roots[idx << (s - domainPow)];
+        return roots[((std::uint64_t)1 << domainPow) + idx];
     }
 
     void printVector(Element* a, std::uint64_t n);
@@ -70,7 +164,6 @@ static inline std::uint64_t BR(std::uint64_t x, std::uint64_t domainPow)
            (32 - domainPow);
 }
 
-#define ROOT(s, j) (rootsOfUnit[(1 << (s)) + (j)])
 
 template <typename Field>
 FFT<Field>::FFT(std::uint64_t maxDomainSize, uint32_t _nThreads)
@@ -120,16 +213,21 @@ FFT<Field>::FFT(std::uint64_t maxDomainSize, uint32_t _nThreads)
 
     uint64_t nRoots = 1LL << s;
 
-    roots.resize(nRoots);
+    // One past the roots of order nRoots, a 1 as root(s + 1, 0), so that
+    // root(k, 2^k - j), the inverse twiddles of a stage, read backwards from
+    // j = 0 without wrapping.
+    roots.resize(2 * nRoots + 1);
+    Element* top = roots.data() + nRoots;
+    f.copy(roots[2 * nRoots], f.one());
 
     powTwoInv.resize(s + 1);
 
-    f.copy(roots[0], f.one());
+    f.copy(top[0], f.one());
     f.copy(powTwoInv[0], f.one());
     if (nRoots > 1)
     {
         mpz_powm(m_aux, m_nqr, m_aux, m_q);
-        f.fromMpz(roots[1], m_aux);
+        f.fromMpz(top[1], m_aux);
 
         mpz_set_ui(m_aux, 2);
         mpz_invert(m_aux, m_aux, m_q);
@@ -148,18 +246,33 @@ FFT<Field>::FFT(std::uint64_t maxDomainSize, uint32_t _nThreads)
                                                : (idSpan + 1) * increment;
                           if (end > start)
                           {
-                              f.exp(roots[start], roots[1], (uint8_t*)(&start),
+                              f.exp(top[start], top[1], (uint8_t*)(&start),
                                     sizeof(start));
                           }
                           for (uint64_t i = start + 1; i < end; i++)
                           {
-                              f.mul(roots[i], roots[i - 1], roots[1]);
+                              f.mul(top[i], top[i - 1], top[1]);
                           }
                       });
     Element aux;
-    f.mul(aux, roots[nRoots - 1], roots[1]);
+    f.mul(aux, top[nRoots - 1], top[1]);
     assert(f.eq(aux, f.one()));
 
+    // The roots of order 2^k are every other root of order 2^(k+1).
+    f.copy(roots[0], f.one());
+    for (std::uint32_t k = s; k > 0; k--)
+    {
+        std::uint64_t half = (std::uint64_t)1 << (k - 1);
+        tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, half),
+                          [&](tbb::blocked_range<std::uint64_t> range)
+                          {
+                              for (auto j = range.begin(); j < range.end(); ++j)
+                              {
+                                  f.copy(roots[half + j], roots[2 * half + 2 * j]);
+                              }
+                          });
+    }
+
     for (uint64_t i = 2; i <= s; i++)
     {
         f.mul(powTwoInv[i], powTwoInv[i - 1], powTwoInv[1]);
@@ -224,36 +337,505 @@ void FFT<Field>::reversePermutation(Element* a, std::uint64_t n)
                       });
 }
 
+// Butterfly i of the Cooley-Tukey stage s, blocks of 2^s points, in each of
+// the count vectors with the twiddle loaded once.
 template <typename Field>
-void FFT<Field>::fft(Element* a, std::uint64_t n)
+template <typename Op>
+inline void FFT<Field>::ditButterfly(Element* const* vecs, std::uint32_t count,
+                                     std::uint32_t s, std::uint64_t i, Op& op)
 {
-    reversePermutation(a, n);
-    std::uint64_t domainPow = log2(n);
-    assert(((std::uint64_t)1 << domainPow) == n);
-    for (std::uint32_t s = 1; s <= domainPow; s++)
+    std::uint64_t mdiv2 = (std::uint64_t)1 << (s - 1);
+    std::uint64_t k     = ((i >> (s - 1)) << s) + (i & (mdiv2 - 1));
+    Element       w;
+    Element       t;
+    Element       u;
+
+    f.copy(w, root(s, i & (mdiv2 - 1)));
+    for (std::uint32_t v = 0; v < count; v++)
     {
-        std::uint64_t m     = 1 << s;
-        std::uint64_t mdiv2 = m >> 1;
+        Element* x = vecs[v] + k;
+        f.mul(t, w, x[mdiv2]);
+        f.copy(u, x[0]);
+        f.add(x[0], t, u);
+        f.sub(x[mdiv2], u, t);
+    }
+    op(k);
+    op(k + mdiv2);
+}
 
-        tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, n >> 1),
-                          [&](tbb::blocked_range<std::uint64_t> range)
+// Butterfly i of the Gentleman-Sande stage s with the inverse roots.
+template <typename Field>
+template <typename Op>
+inline void FFT<Field>::difButterfly(Element* const* vecs, std::uint32_t count,
+                                     std::uint32_t s, std::uint64_t i, Op& op)
+{
+    std::uint64_t m     = (std::uint64_t)1 << s;
+    std::uint64_t mdiv2 = m >> 1;
+    std::uint64_t j     = i & (mdiv2 - 1);
+    std::uint64_t k     = ((i >> (s - 1)) << s) + j;
+    Element       w;
+    Element       u;
+    Element       v;
+
+    f.copy(w, root(s, (m - j) & (m - 1)));
+    for (std::uint32_t l = 0; l < count; l++)
+    {
+        Element* x = vecs[l] + k;
+        f.copy(u, x[0]);
+        f.sub(v, u, x[mdiv2]);
+        f.add(x[0], u, x[mdiv2]);
+        f.mul(x[mdiv2], v, w);
+    }
+    op(k);
+    op(k + mdiv2);
+}
+
+// Radix-4 butterfly i of the Cooley-Tukey stages s and s + 1: the four points
+// of the two stage s butterflies feeding two stage s + 1 butterflies are
+// loaded once and go through both stages in registers.
+template <typename Field>
+template <typename Op>
+inline void FFT<Field>::ditButterfly4(Element* const* vecs,
+                                      std::uint32_t count, std::uint32_t s,
+                                      std::uint64_t i, Op& op)
+{
+    std::uint64_t q = (std::uint64_t)1 << (s - 1);
+    std::uint64_t j = i & (q - 1);
+    std::uint64_t k = ((i >> (s - 1)) << (s + 1)) + j;
+    Element       w0, w1, w2;
+    Element       t0, t1, y0, y1, y2, y3;
+
+    f.copy(w0, root(s, j));
+    f.copy(w1, root(s + 1, j));
+    f.copy(w2, root(s + 1, j + q));
+    for (std::uint32_t v = 0; v < count; v++)
+    {
+        Element* x = vecs[v] + k;
+
+        f.mul(t0, w0, x[q]);
+        f.mul(t1, w0, x[3 * q]);
+        f.add(y0, x[0], t0);
+        f.sub(y1, x[0], t0);
+        f.add(y2, x[2 * q], t1);
+        f.sub(y3, x[2 * q], t1);
+
+        f.mul(t0, w1, y2);
+        f.mul(t1, w2, y3);
+        f.add(x[0], y0, t0);
+        f.sub(x[2 * q], y0, t0);
+        f.add(x[q], y1, t1);
+        f.sub(x[3 * q], y1, t1);
+    }
+    op(k);
+    op(k + q);
+    op(k + 2 * q);
+    op(k + 3 * q);
+}
+
+// Radix-4 butterfly i of the Gentleman-Sande stages s + 1 and then s.
+template <typename Field>
+template <typename Op>
+inline void FFT<Field>::difButterfly4(Element* const* vecs,
+                                      std::uint32_t count, std::uint32_t s,
+                                      std::uint64_t i, Op& op)
+{
+    std::uint64_t q  = (std::uint64_t)1 << (s - 1);
+    std::uint64_t m  = q << 1;
+    std::uint64_t m2 = q << 2;
+    std::uint64_t j  = i & (q - 1);
+    std::uint64_t k  = ((i >> (s - 1)) << (s + 1)) + j;
+    Element       w0, w1, w2;
+    Element       t0, t1, y0, y1, y2, y3;
+
+    f.copy(w0, root(s, (m - j) & (m - 1)));
+    f.copy(w1, root(s + 1, (m2 - j) & (m2 - 1)));
+    f.copy(w2, root(s + 1, (m2 - j - q) & (m2 - 1)));
+    for (std::uint32_t v = 0; v < count; v++)
+    {
+        Element* x = vecs[v] + k;
+
+        f.add(y0, x[0], x[2 * q]);
+        f.sub(t0, x[0], x[2 * q]);
+        f.mul(y2, t0, w1);
+        f.add(y1, x[q], x[3 * q]);
+        f.sub(t1, x[q], x[3 * q]);
+        f.mul(y3, t1, w2);
+
+        f.add(x[0], y0, y1);
+        f.sub(t0, y0, y1);
+        f.mul(x[q], t0, w0);
+        f.add(x[2 * q], y2, y3);
+        f.sub(t1, y2, y3);
+        f.mul(x[3 * q], t1, w0);
+    }
+    op(k);
+    op(k + q);
+    op(k + 2 * q);
+    op(k + 3 * q);
+}
+
+// The butterflies [begin, end) through the Fr batch kernels: those of a
+// block with consecutive j read consecutive points and twiddles, so they go
+// in runs of up to FFT_BATCH_RUN, every run through all its stages for one
+// vector at a time while it is in L1.
+template <typename Field>
+template <bool dif, typename Op>
+void FFT<Field>::batchButterflies(Element* const* vecs, std::uint32_t count,
+                                  std::uint32_t s, bool radix4,
+                                  std::uint64_t begin, std::uint64_t end,
+                                  Op& op)
+{
+    std::uint64_t q = (std::uint64_t)1 << (s - 1);
+    std::uint32_t r = radix4 ? 2 : 1;
+
+    for (std::uint64_t i = begin; i < end;)
+    {
+        std::uint64_t j   = i & (q - 1);
+        std::uint64_t len = std::min<std::uint64_t>(
+            {end - i, q - j, FFT_BATCH_RUN});
+        std::uint64_t k   = ((i >> (s - 1)) << (s - 1 + r)) + j;
+
+        for (std::uint32_t v = 0; v < count; v++)
+        {
+            Element* x = vecs[v] + k;
+            if (!radix4)
+            {
+                if constexpr (dif)
+                    Fr_rawInvButterflyBatch(x, x + q, &root(s, 2 * q - j),
+                                            len);
+                else
+                    Fr_rawButterflyBatch(x, x + q, &root(s, j), len);
+                continue;
+            }
+            if constexpr (dif)
+            {
+                Fr_rawInvButterflyBatch(x, x + 2 * q,
+                                        &root(s + 1, 4 * q - j), len);
+                Fr_rawInvButterflyBatch(x + q, x + 3 * q,
+                                        &root(s + 1, 3 * q - j), len);
+                Fr_rawInvButterflyBatch(x, x + q, &root(s, 2 * q - j), len);
+                Fr_rawInvButterflyBatch(x + 2 * q, x + 3 * q,
+                                        &root(s, 2 * q - j), len);
+            }
+            else
+            {
+                Fr_rawButterflyBatch(x, x + q, &root(s, j), len);
+                Fr_rawButterflyBatch(x + 2 * q, x + 3 * q, &root(s, j), len);
+                Fr_rawButterflyBatch(x, x + 2 * q, &root(s + 1, j), len);
+                Fr_rawButterflyBatch(x + q, x + 3 * q, &root(s + 1, j + q),
+                                     len);
+            }
+        }
+
+        for (std::uint64_t t = 0; t < len; t++)
+        {
+            for (std::uint64_t p = 0; p < ((std::uint64_t)1 << r); p++)
+            {
+                op(k + p * q + t);
+            }
+        }
+        i += len;
+    }
+}
+
+// Butterflies [begin, end) of the pass at stage s, of stages s and s + 1 if
+// radix4, where there are n / 4 butterflies rather than n / 2.
+template <typename Field>
+template <bool dif, typename Op>
+inline void FFT<Field>::butterflies(Element* const* vecs, std::uint32_t count,
+                                    std::uint32_t s, bool radix4,
+                                    std::uint64_t begin, std::uint64_t end,
+                                    Op& op)
+{
+    if constexpr (std::is_same_v<Field, RawFr>)
+    {
+        if (((std::uint64_t)1 << (s - 1)) >= FFT_BATCH_MIN_RUN)
+        {
+            batchButterflies<dif>(vecs, count, s, radix4, begin, end, op);
+            return;
+        }
+    }
+    if (radix4)
+    {
+        for (std::uint64_t i = begin; i < end; i++)
+        {
+            if constexpr (dif)
+                difButterfly4(vecs, count, s, i, op);
+            else
+                ditButterfly4(vecs, count, s, i, op);
+        }
+        return;
+    }
+    for (std::uint64_t i = begin; i < end; i++)
+    {
+        if constexpr (dif)
+            difButterfly(vecs, count, s, i, op);
+        else
+            ditButterfly(vecs, count, s, i, op);
+    }
+}
+
+// Runs the stages [lo, hi] two at a time, bottom up for the DIT and top down
+// for the DIF, with a radix-2 pass for the odd one left at the end.
+// pass(s, radix4, op) runs stage s, and s + 1 if radix4; op is only handed
+// to the pass holding lastStage.
+template <typename Field>
+template <bool dif, typename Op, typename Pass>
+inline void FFT<Field>::passes(std::uint32_t lo, std::uint32_t hi,
+                               std::uint32_t lastStage, Op& op, Pass pass)
+{
+    auto noOp = [](std::uint64_t) {};
+
+    auto run = [&](std::uint32_t s, bool radix4)
+    {
+        if (s == lastStage || (radix4 && s + 1 == lastStage))
+            pass(s, radix4, op);
+        else
+            pass(s, radix4, noOp);
+    };
+
+    if constexpr (dif)
+    {
+        std::uint32_t s = hi;
+        for (; s > lo; s -= 2)
+        {
+            run(s - 1, true);
+        }
+        if (s == lo)
+            run(lo, false);
+    }
+    else
+    {
+        std::uint32_t s = lo;
+        for (; s < hi; s += 2)
+        {
+            run(s, true);
+        }
+        if (s == hi)
+            run(hi, false);
+    }
+}
+
+// Transform of the 2^m points from base: below FFT_SERIAL_BLOCK_BITS all its
+// stages run on the calling task. Above, its quarters, or halves, are
+// transformed as parallel tasks with their lower stages, and only its own top
+// one or two stages are a parallel pass over the whole block, after the
+// sub blocks for the DIT and before them for the DIF.
+template <typename Field>
+template <bool dif, typename Op>
+void FFT<Field>::block(Element* const* vecs, std::uint32_t count,
+                       std::uint64_t base, std::uint32_t m,
+                       std::uint32_t lastStage, Op& op)
+{
+    if (m <= FFT_SERIAL_BLOCK_BITS)
+    {
+        passes<dif>(1, m, lastStage, op,
+                    [&](std::uint32_t s, bool radix4, auto& o)
+                    {
+                        std::uint32_t r = radix4 ? 2 : 1;
+                        butterflies<dif>(vecs, count, s, radix4, base >> r,
+                                         (base + ((std::uint64_t)1 << m)) >> r,
+                                         o);
+                    });
+        return;
+    }
+
+    std::uint32_t top = m - FFT_SERIAL_BLOCK_BITS >= 2 ? 2 : 1;
+
+    auto topPasses = [&]()
+    {
+        passes<dif>(
+            m - top + 1, m, lastStage, op,
+            [&](std::uint32_t s, bool radix4, auto& o)
+            {
+                std::uint32_t r = radix4 ? 2 : 1;
+                tbb::parallel_for(
+                    tbb::blocked_range<std::uint64_t>(
+                        base >> r, (base + ((std::uint64_t)1 << m)) >> r,
+                        (std::uint64_t)1 << (FFT_SERIAL_BLOCK_BITS - r)),
+                    [&](tbb::blocked_range<std::uint64_t> range) {
+                        butterflies<dif>(vecs, count, s, radix4,
+                                         range.begin(), range.end(), o);
+                    });
+            });
+    };
+
+    auto subBlocks = [&]()
+    {
+        tbb::parallel_for((std::uint64_t)0, (std::uint64_t)1 << top,
+                          [&](std::uint64_t b)
                           {
-                              for (int i = range.begin(); i < range.end(); ++i)
-                              {
-                                  Element       t;
-                                  Element       u;
-                                  std::uint64_t k = (i / mdiv2) * m;
-                                  std::uint64_t j = i % mdiv2;
-
-                                  f.mul(t, root(s, j), a[k + j + mdiv2]);
-                                  f.copy(u, a[k + j]);
-                                  f.add(a[k + j], t, u);
-                                  f.sub(a[k + j + mdiv2], u, t);
-                              }
+                              block<dif>(vecs, count, base + (b << (m - top)),
+                                         m - top, lastStage, op);
                           });
+    };
+
+    if constexpr (dif)
+    {
+        topPasses();
+        subBlocks();
+    }
+    else
+    {
+        subBlocks();
+        topPasses();
     }
 }
 
+// The points are seen as 2^(domainPow - rowBits) rows of 2^rowBits. The
+// stages up to rowBits only mix points of the same row and the later ones
+// only points of the same column, their twiddles playing the part of the
+// twiddle multiply between the row and column transforms. So each row, and
+// then each group of adjacent columns, goes through all its stages while it
+// is in cache, in place and without transposing. The DIF runs the column
+// transforms first. op gets the outputs of the last stage.
+template <typename Field>
+template <bool dif, typename Op>
+void FFT<Field>::fourStep(Element* const* vecs, std::uint32_t count,
+                          std::uint32_t domainPow, Op& op)
+{
+    std::uint32_t rowBits =
+        std::min<std::uint32_t>(FFT_FOUR_STEP_ROW_BITS, domainPow - 1);
+    std::uint64_t rowSize   = (std::uint64_t)1 << rowBits;
+    std::uint64_t nRows     = (std::uint64_t)1 << (domainPow - rowBits);
+    std::uint32_t lastStage = dif ? 1 : domainPow;
+
+    auto rows = [&]()
+    {
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint64_t>(0, nRows),
+            [&](tbb::blocked_range<std::uint64_t> range)
+            {
+                for (auto r = range.begin(); r < range.end(); ++r)
+                {
+                    passes<dif>(
+                        1, rowBits, lastStage, op,
+                        [&](std::uint32_t s, bool radix4, auto& o)
+                        {
+                            std::uint64_t size = rowSize >> (radix4 ? 2 : 1);
+                            butterflies<dif>(vecs, count, s, radix4, r * size,
+                                             (r + 1) * size, o);
+                        });
+                }
+            });
+    };
+
+    // Butterfly i of a pass above rowBits is in column i mod rowSize.
+    auto columns = [&]()
+    {
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint64_t>(0, rowSize,
+                                              FFT_FOUR_STEP_COLUMNS),
+            [&](tbb::blocked_range<std::uint64_t> range)
+            {
+                for (auto c = range.begin(); c < range.end();
+                     c += FFT_FOUR_STEP_COLUMNS)
+                {
+                    std::uint64_t width = std::min<std::uint64_t>(
+                        FFT_FOUR_STEP_COLUMNS, range.end() - c);
+                    passes<dif>(
+                        rowBits + 1, domainPow, lastStage, op,
+                        [&](std::uint32_t s, bool radix4, auto& o)
+                        {
+                            for (std::uint64_t q = 0;
+                                 q < nRows >> (radix4 ? 2 : 1); q++)
+                            {
+                                std::uint64_t begin = (q << rowBits) + c;
+                                butterflies<dif>(vecs, count, s, radix4, begin,
+                                                 begin + width, o);
+                            }
+                        });
+                }
+            });
+    };
+
+    if constexpr (dif)
+    {
+        columns();
+        rows();
+    }
+    else
+    {
+        rows();
+        columns();
+    }
+}
+
+// All the stages of the DIT or of the DIF over count vectors of n points.
+// op(i) runs once every vector has its output i.
+template <typename Field>
+template <bool dif, typename Op>
+void FFT<Field>::transform(Element* const* vecs, std::uint32_t count,
+                           std::uint64_t n, Op op)
+{
+    std::uint32_t domainPow = log2(n);
+    assert(((std::uint64_t)1 << domainPow) == n);
+    if (domainPow == 0)
+    {
+        op(0);
+        return;
+    }
+    if (domainPow >= FFT_FOUR_STEP_MIN_POW)
+    {
+        fourStep<dif>(vecs, count, domainPow, op);
+        return;
+    }
+    block<dif>(vecs, count, 0, domainPow, dif ? 1 : domainPow, op);
+}
+
+template <typename Field>
+void FFT<Field>::fft(Element* a, std::uint64_t n)
+{
+    fft(a, n, [](std::uint64_t, Element&) {});
+}
+
+template <typename Field>
+template <typename Op>
+void FFT<Field>::fft(Element* a, std::uint64_t n, Op op)
+{
+    reversePermutation(a, n);
+    fftDit(a, n, op);
+}
+
+template <typename Field>
+void FFT<Field>::fftBatch(Element* const* vecs, std::uint32_t count,
+                          std::uint64_t n)
+{
+    for (std::uint32_t v = 0; v < count; v++)
+    {
+        reversePermutation(vecs[v], n);
+    }
+    fftDitBatch(vecs, count, n);
+}
+
+template <typename Field>
+void FFT<Field>::fftDit(Element* a, std::uint64_t n)
+{
+    transform<false>(&a, 1, n, [](std::uint64_t) {});
+}
+
+template <typename Field>
+template <typename Op>
+void FFT<Field>::fftDit(Element* a, std::uint64_t n, Op op)
+{
+    transform<false>(&a, 1, n, [&](std::uint64_t i) { op(i, a[i]); });
+}
+
+template <typename Field>
+void FFT<Field>::fftDitBatch(Element* const* vecs, std::uint32_t count,
+                             std::uint64_t n)
+{
+    transform<false>(vecs, count, n, [](std::uint64_t) {});
+}
+
+template <typename Field>
+template <typename Op>
+void FFT<Field>::fftDitBatch(Element* const* vecs, std::uint32_t count,
+                             std::uint64_t n, Op op)
+{
+    transform<false>(vecs, count, n, op);
+}
+
 template <typename Field>
 void FFT<Field>::ifft(Element* a, std::uint64_t n)
 {
@@ -281,6 +863,69 @@ void FFT<Field>::ifft(Element* a, std::uint64_t n)
     f.mul(a[n >> 1], a[n >> 1], powTwoInv[domainPow]);
 }
 
+template <typename Field>
+void FFT<Field>::ifftDif(Element* a, std::uint64_t n)
+{
+    std::uint32_t domainPow = log2(n);
+
+    transform<true>(&a, 1, n, [&](std::uint64_t i)
+                    { f.mul(a[i], a[i], powTwoInv[domainPow]); });
+}
+
+template <typename Field>
+void FFT<Field>::ifftCosetDif(Element* a, std::uint64_t n)
+{
+    ifftCosetDifBatch(&a, 1, n);
+}
+
+// Position i gets the shift power BR(i), read from two small tables of the
+// low and high bits of i rather than all over the roots, 1/n folded in.
+template <typename Field>
+void FFT<Field>::ifftCosetDifBatch(Element* const* vecs, std::uint32_t count,
+                                   std::uint64_t n)
+{
+    std::uint32_t domainPow = log2(n);
+    std::uint32_t lowBits   = domainPow / 2;
+    std::uint32_t highBits  = domainPow - lowBits;
+    std::uint64_t lowMask   = ((std::uint64_t)1 << lowBits) - 1;
+
+    std::vector<Element> low((std::uint64_t)1 << lowBits);
+    std::vector<Element> high((std::uint64_t)1 << highBits);
+    for (std::uint64_t i = 0; i < low.size(); i++)
+    {
+        f.copy(low[i], root(domainPow + 1, BR(i, lowBits) << highBits));
+    }
+    for (std::uint64_t i = 0; i < high.size(); i++)
+    {
+        f.mul(high[i], powTwoInv[domainPow],
+              root(domainPow + 1, BR(i, highBits)));
+    }
+
+    transform<true>(vecs, count, n,
+                    [&](std::uint64_t i)
+                    {
+                        for (std::uint32_t v = 0; v < count; v++)
+                        {
+                            f.mul(vecs[v][i], vecs[v][i], low[i & lowMask]);
+                            f.mul(vecs[v][i], vecs[v][i], high[i >> lowBits]);
+                        }
+                    });
+}
+
+template <typename Field>
+void FFT<Field>::fftCoset(Element* a, std::uint64_t n)
+{
+    fftCosetBatch(&a, 1, n);
+}
+
+template <typename Field>
+void FFT<Field>::fftCosetBatch(Element* const* vecs, std::uint32_t count,
+                               std::uint64_t n)
+{
+    ifftCosetDifBatch(vecs, count, n);
+    fftDitBatch(vecs, count, n);
+}
+
 template <typename Field>
 void FFT<Field>::printVector(Element* a, std::uint64_t n)
 {
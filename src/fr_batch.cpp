@@ -0,0 +1,386 @@
+#include "fr_batch.hpp"
+
+#include <cstring>
+
+// Set to 0 to build only the scalar kernels.
+#ifndef FR_BATCH_IFMA
+#    define FR_BATCH_IFMA 1
+#endif
+
+#if FR_BATCH_IFMA && defined(__x86_64__) && defined(__GNUC__)
+#    define FR_BATCH_HAS_IFMA
+#    include <immintrin.h>
+#endif
+
+namespace
+{
+
+void mmulScalar(RawFr::Element* r, const RawFr::Element* a,
+                const RawFr::Element* b, std::uint64_t n)
+{
+    for (std::uint64_t i = 0; i < n; i++)
+    {
+        Fr_rawMMul(r[i].v, a[i].v, b[i].v);
+    }
+}
+
+void butterflyScalar(RawFr::Element* a, RawFr::Element* b,
+                     const RawFr::Element* w, std::uint64_t n)
+{
+    for (std::uint64_t i = 0; i < n; i++)
+    {
+        FrRawElement t;
+        FrRawElement u;
+
+        Fr_rawMMul(t, w[i].v, b[i].v);
+        Fr_rawCopy(u, a[i].v);
+        Fr_rawAdd(a[i].v, u, t);
+        Fr_rawSub(b[i].v, u, t);
+    }
+}
+
+void invButterflyScalar(RawFr::Element* a, RawFr::Element* b,
+                        const RawFr::Element* w, std::uint64_t n)
+{
+    for (std::uint64_t i = 0; i < n; i++)
+    {
+        FrRawElement u;
+        FrRawElement v;
+
+        Fr_rawCopy(u, a[i].v);
+        Fr_rawSub(v, u, b[i].v);
+        Fr_rawAdd(a[i].v, u, b[i].v);
+        Fr_rawMMul(b[i].v, v, w[-(std::int64_t)i].v);
+    }
+}
+
+#ifdef FR_BATCH_HAS_IFMA
+
+#    define IFMA __attribute__((target("avx512f,avx512ifma")))
+
+// Eight elements, limb j of each in lane i of l[j]: 5 x 52 bits cover the
+// 254 bits of Fr and leave room for the 16x below.
+struct Limbs
+{
+    __m512i l[5];
+};
+
+const std::uint64_t mask52 = ((std::uint64_t)1 << 52) - 1;
+
+// q in 52 bit limbs and -1/q mod 2^52.
+struct Modulus
+{
+    std::uint64_t q[5];
+    std::uint64_t np;
+
+    Modulus()
+    {
+        std::uint64_t w[4];
+        std::memcpy(w, &Fr_q.longVal, sizeof(w));
+
+        q[0] = w[0] & mask52;
+        q[1] = ((w[0] >> 52) | (w[1] << 12)) & mask52;
+        q[2] = ((w[1] >> 40) | (w[2] << 24)) & mask52;
+        q[3] = ((w[2] >> 28) | (w[3] << 36)) & mask52;
+        q[4] = w[3] >> 16;
+
+        std::uint64_t inv = 1;
+        for (int i = 0; i < 6; i++)
+        {
+            inv *= 2 - w[0] * inv;
+        }
+        np = (0 - inv) & mask52;
+    }
+};
+
+const Modulus modulus;
+
+// The plain shift and gather intrinsics pass an undefined vector through,
+// which GCC reports as maybe uninitialized. These pass zeros through under
+// an all set mask, the same instructions.
+template <unsigned n>
+IFMA inline __m512i shl(__m512i x)
+{
+    return _mm512_maskz_slli_epi64(0xFF, x, n);
+}
+
+template <unsigned n>
+IFMA inline __m512i shr(__m512i x)
+{
+    return _mm512_maskz_srli_epi64(0xFF, x, n);
+}
+
+// Lane i reads the element at p[i], or at p[-i] backwards.
+IFMA inline void gather(__m512i w[4], const RawFr::Element* p,
+                        bool backwards)
+{
+    __m512i idx = backwards
+                      ? _mm512_set_epi64(-28, -24, -20, -16, -12, -8, -4, 0)
+                      : _mm512_set_epi64(28, 24, 20, 16, 12, 8, 4, 0);
+    for (int k = 0; k < 4; k++)
+    {
+        w[k] = _mm512_mask_i64gather_epi64(_mm512_setzero_si512(), 0xFF, idx,
+                                           (const void*)(p->v + k), 8);
+    }
+}
+
+IFMA inline void scatter(RawFr::Element* p, const __m512i w[4])
+{
+    __m512i idx = _mm512_set_epi64(28, 24, 20, 16, 12, 8, 4, 0);
+    for (int k = 0; k < 4; k++)
+    {
+        _mm512_i64scatter_epi64((void*)(p->v + k), idx, w[k], 8);
+    }
+}
+
+IFMA inline void load(Limbs& x, const RawFr::Element* p,
+                      bool backwards = false)
+{
+    __m512i w[4];
+    __m512i m = _mm512_set1_epi64(mask52);
+
+    gather(w, p, backwards);
+    x.l[0] = _mm512_and_si512(w[0], m);
+    x.l[1] = _mm512_and_si512(_mm512_or_si512(shr<52>(w[0]), shl<12>(w[1])), m);
+    x.l[2] = _mm512_and_si512(_mm512_or_si512(shr<40>(w[1]), shl<24>(w[2])), m);
+    x.l[3] = _mm512_and_si512(_mm512_or_si512(shr<28>(w[2]), shl<36>(w[3])), m);
+    x.l[4] = shr<16>(w[3]);
+}
+
+// Loads 16 times the elements, unreduced below 2^258, so that the Montgomery
+// product by 2^-260 of the 52 bit limbs comes out in the 2^-256 of RawFr.
+IFMA inline void load16(Limbs& x, const RawFr::Element* p,
+                        bool backwards = false)
+{
+    __m512i w[4];
+    __m512i m = _mm512_set1_epi64(mask52);
+
+    gather(w, p, backwards);
+    x.l[0] = _mm512_and_si512(shl<4>(w[0]), m);
+    x.l[1] = _mm512_and_si512(_mm512_or_si512(shr<48>(w[0]), shl<16>(w[1])), m);
+    x.l[2] = _mm512_and_si512(_mm512_or_si512(shr<36>(w[1]), shl<28>(w[2])), m);
+    x.l[3] = _mm512_and_si512(_mm512_or_si512(shr<24>(w[2]), shl<40>(w[3])), m);
+    x.l[4] = shr<12>(w[3]);
+}
+
+IFMA inline void store(RawFr::Element* p, const Limbs& x)
+{
+    __m512i w[4];
+
+    w[0] = _mm512_or_si512(x.l[0], shl<52>(x.l[1]));
+    w[1] = _mm512_or_si512(shr<12>(x.l[1]), shl<40>(x.l[2]));
+    w[2] = _mm512_or_si512(shr<24>(x.l[2]), shl<28>(x.l[3]));
+    w[3] = _mm512_or_si512(shr<36>(x.l[3]), shl<16>(x.l[4]));
+    scatter(p, w);
+}
+
+// x < 2q to x mod q.
+IFMA inline void reduce(Limbs& x)
+{
+    __m512i m      = _mm512_set1_epi64(mask52);
+    __m512i borrow = _mm512_setzero_si512();
+    __m512i d[5];
+
+    for (int j = 0; j < 5; j++)
+    {
+        d[j]   = _mm512_sub_epi64(
+            _mm512_sub_epi64(x.l[j], _mm512_set1_epi64(modulus.q[j])), borrow);
+        borrow = shr<63>(d[j]);
+        d[j]   = _mm512_and_si512(d[j], m);
+    }
+    __mmask8 keep = _mm512_test_epi64_mask(borrow, borrow);
+    for (int j = 0; j < 5; j++)
+    {
+        x.l[j] = _mm512_mask_mov_epi64(d[j], keep, x.l[j]);
+    }
+}
+
+// r = a16 * b / 2^260 mod q, operand scanning with the reduction of each
+// limb interleaved, the sums of the 52 bit halves kept in 64 bit lanes.
+IFMA inline void mul(Limbs& r, const Limbs& a16, const Limbs& b)
+{
+    __m512i zero = _mm512_setzero_si512();
+    __m512i m    = _mm512_set1_epi64(mask52);
+    __m512i np   = _mm512_set1_epi64(modulus.np);
+    __m512i t[6] = {zero, zero, zero, zero, zero, zero};
+
+    for (int i = 0; i < 5; i++)
+    {
+        for (int j = 0; j < 5; j++)
+        {
+            t[j]     = _mm512_madd52lo_epu64(t[j], a16.l[i], b.l[j]);
+            t[j + 1] = _mm512_madd52hi_epu64(t[j + 1], a16.l[i], b.l[j]);
+        }
+        __m512i u = _mm512_madd52lo_epu64(zero, t[0], np);
+        for (int j = 0; j < 5; j++)
+        {
+            __m512i q = _mm512_set1_epi64(modulus.q[j]);
+            t[j]      = _mm512_madd52lo_epu64(t[j], u, q);
+            t[j + 1]  = _mm512_madd52hi_epu64(t[j + 1], u, q);
+        }
+        t[1] = _mm512_add_epi64(t[1], shr<52>(t[0]));
+        for (int j = 0; j < 5; j++)
+        {
+            t[j] = t[j + 1];
+        }
+        t[5] = zero;
+    }
+
+    for (int j = 0; j < 4; j++)
+    {
+        t[j + 1] = _mm512_add_epi64(t[j + 1], shr<52>(t[j]));
+        r.l[j]   = _mm512_and_si512(t[j], m);
+    }
+    r.l[4] = t[4];
+    reduce(r);
+}
+
+IFMA inline void add(Limbs& r, const Limbs& a, const Limbs& b)
+{
+    __m512i m     = _mm512_set1_epi64(mask52);
+    __m512i carry = _mm512_setzero_si512();
+
+    for (int j = 0; j < 4; j++)
+    {
+        __m512i s = _mm512_add_epi64(_mm512_add_epi64(a.l[j], b.l[j]), carry);
+        carry     = shr<52>(s);
+        r.l[j]    = _mm512_and_si512(s, m);
+    }
+    r.l[4] = _mm512_add_epi64(_mm512_add_epi64(a.l[4], b.l[4]), carry);
+    reduce(r);
+}
+
+IFMA inline void sub(Limbs& r, const Limbs& a, const Limbs& b)
+{
+    __m512i m      = _mm512_set1_epi64(mask52);
+    __m512i borrow = _mm512_setzero_si512();
+    __m512i carry  = _mm512_setzero_si512();
+    __m512i d[5];
+
+    for (int j = 0; j < 5; j++)
+    {
+        d[j]   = _mm512_sub_epi64(_mm512_sub_epi64(a.l[j], b.l[j]), borrow);
+        borrow = shr<63>(d[j]);
+        d[j]   = _mm512_and_si512(d[j], m);
+    }
+    __mmask8 wrap = _mm512_test_epi64_mask(borrow, borrow);
+    for (int j = 0; j < 5; j++)
+    {
+        __m512i e = _mm512_add_epi64(
+            _mm512_add_epi64(d[j], _mm512_set1_epi64(modulus.q[j])), carry);
+        carry  = shr<52>(e);
+        r.l[j] = _mm512_mask_and_epi64(d[j], wrap, e, m);
+    }
+}
+
+IFMA void mmulIfma(RawFr::Element* r, const RawFr::Element* a,
+                   const RawFr::Element* b, std::uint64_t n)
+{
+    std::uint64_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        Limbs x, y;
+        load16(x, a + i);
+        load(y, b + i);
+        mul(x, x, y);
+        store(r + i, x);
+    }
+    mmulScalar(r + i, a + i, b + i, n - i);
+}
+
+IFMA void butterflyIfma(RawFr::Element* a, RawFr::Element* b,
+                        const RawFr::Element* w, std::uint64_t n)
+{
+    std::uint64_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        Limbs x, y, t;
+        load16(t, w + i);
+        load(y, b + i);
+        mul(t, t, y);
+        load(x, a + i);
+        add(y, x, t);
+        sub(x, x, t);
+        store(a + i, y);
+        store(b + i, x);
+    }
+    butterflyScalar(a + i, b + i, w + i, n - i);
+}
+
+IFMA void invButterflyIfma(RawFr::Element* a, RawFr::Element* b,
+                           const RawFr::Element* w, std::uint64_t n)
+{
+    std::uint64_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        Limbs x, y, t;
+        load(x, a + i);
+        load(y, b + i);
+        sub(t, x, y);
+        add(x, x, y);
+        load16(y, w - i, true);
+        mul(t, y, t);
+        store(a + i, x);
+        store(b + i, t);
+    }
+    invButterflyScalar(a + i, b + i, w - i, n - i);
+}
+
+#endif // FR_BATCH_HAS_IFMA
+
+struct Kernels
+{
+    decltype(&mmulScalar)         mmul;
+    decltype(&butterflyScalar)    butterfly;
+    decltype(&invButterflyScalar) invButterfly;
+    const char*                   name;
+
+    Kernels()
+        : mmul(mmulScalar)
+        , butterfly(butterflyScalar)
+        , invButterfly(invButterflyScalar)
+        , name("scalar")
+    {
+#ifdef FR_BATCH_HAS_IFMA
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512ifma"))
+        {
+            mmul         = mmulIfma;
+            butterfly    = butterflyIfma;
+            invButterfly = invButterflyIfma;
+            name         = "avx512ifma";
+        }
+#endif
+    }
+};
+
+const Kernels& kernels()
+{
+    static const Kernels k;
+    return k;
+}
+
+} // namespace
+
+void Fr_rawMMulBatch(RawFr::Element* r, const RawFr::Element* a,
+                     const RawFr::Element* b, std::uint64_t n)
+{
+    kernels().mmul(r, a, b, n);
+}
+
+void Fr_rawButterflyBatch(RawFr::Element* a, RawFr::Element* b,
+                          const RawFr::Element* w, std::uint64_t n)
+{
+    kernels().butterfly(a, b, w, n);
+}
+
+void Fr_rawInvButterflyBatch(RawFr::Element* a, RawFr::Element* b,
+                             const RawFr::Element* w, std::uint64_t n)
+{
+    kernels().invButterfly(a, b, w, n);
+}
+
+const char* Fr_batchKernel()
+{
+    return kernels().name;
+}
@@ -0,0 +1,31 @@
+#ifndef FR_BATCH_HPP
+#define FR_BATCH_HPP
+
+#include "fr.hpp"
+
+#include <cstdint>
+
+// Montgomery arithmetic over arrays of Fr elements, vectorized across
+// elements. The kernel is picked once at startup: eight elements at a time
+// in 52 bit limbs with AVX-512 IFMA where the CPU has it, the scalar
+// Fr_raw* functions otherwise. Outputs may alias inputs.
+
+// r[i] = a[i] * b[i]
+void Fr_rawMMulBatch(RawFr::Element* r, const RawFr::Element* a,
+                     const RawFr::Element* b, std::uint64_t n);
+
+// Cooley-Tukey butterflies: (a[i], b[i]) = (a[i] + w[i] * b[i],
+// a[i] - w[i] * b[i]).
+void Fr_rawButterflyBatch(RawFr::Element* a, RawFr::Element* b,
+                          const RawFr::Element* w, std::uint64_t n);
+
+// Gentleman-Sande butterflies: (a[i], b[i]) = (a[i] + b[i],
+// (a[i] - b[i]) * w[-i]), the twiddles read backwards as the inverse roots
+// of a stage are.
+void Fr_rawInvButterflyBatch(RawFr::Element* a, RawFr::Element* b,
+                             const RawFr::Element* w, std::uint64_t n);
+
+// Name of the kernel in use, for the logs.
+const char* Fr_batchKernel();
+
+#endif // FR_BATCH_HPP
@@ -11,10 +11,12 @@
 #include "alt_bn128.hpp"
 #include "binfile_utils.hpp"
 #include "fr.hpp"
+#include "fr_batch.hpp"
 #include "fullprover.hpp"
 #include "groth16.hpp"
 #include "logging.hpp"
 #include "nlohmann/json.hpp"
+#include "proof_slots.hpp"
 #include "wtns_utils.hpp"
 #include "zkey_utils.hpp"
 
@@ -29,13 +31,27 @@ class FullProverImpl
     std::unique_ptr<Groth16::Prover<AltBn128::Engine>> prover;
     std::unique_ptr<ZKeyUtils::Header>                 zkHeader;
     std::unique_ptr<BinFileUtils::BinFile>             zKey;
+    std::unique_ptr<ProofSlots>                        slots;
 
     mpz_t altBbn128r;
 
+    // Runs f in a proof slot, if there are any.
+    template <typename F>
+    auto inSlot(F&& f) const -> decltype(f())
+    {
+        if (slots)
+            return slots->run(std::forward<F>(f));
+        return f();
+    }
+
 public:
-    FullProverImpl(const char* _zkeyFileName);
+    FullProverImpl(const char* _zkeyFileName, size_t fixedBaseMemoryMB,
+                   size_t multiexpMemoryMB, size_t proofSlots,
+                   size_t threadsPerSlot, bool pinProofSlots);
     ~FullProverImpl();
     ProverResponse prove(const char* input) const;
+    std::vector<std::unique_ptr<ProverResponse>>
+    proveBatch(const char* const* inputs, size_t n) const;
 };
 
 std::string getFormattedTimestamp()
@@ -76,14 +92,18 @@ void log_info(std::string msg) { log("INFO", msg); }
 void log_debug(std::string msg) { log("DEBUG", msg); }
 void log_error(std::string msg) { log("ERROR", msg); }
 
-FullProver::FullProver(const char* _zkeyFileName)
+FullProver::FullProver(const char* _zkeyFileName, size_t fixedBaseMemoryMB,
+                       size_t multiexpMemoryMB, size_t proofSlots,
+                       size_t threadsPerSlot, bool pinProofSlots)
 {
     // std::cout << "in FullProver constructor" << std::endl;
     impl = nullptr;
     try
     {
         // std::cout << "try" << std::endl;
-        auto impl_uptr = std::make_unique<FullProverImpl>(_zkeyFileName);
+        auto impl_uptr = std::make_unique<FullProverImpl>(
+            _zkeyFileName, fixedBaseMemoryMB, multiexpMemoryMB, proofSlots,
+            threadsPerSlot, pinProofSlots);
         impl = impl_uptr.release();
         state = FullProverState::OK;
     }
@@ -123,6 +143,22 @@ ProverResponse FullProver::prove(const char* input) const
     }
 }
 
+std::vector<std::unique_ptr<ProverResponse>>
+FullProver::proveBatch(const char* const* inputs, size_t n) const
+{
+    if (state != FullProverState::OK)
+    {
+        std::vector<std::unique_ptr<ProverResponse>> responses;
+        for (size_t i = 0; i < n; i++)
+        {
+            responses.push_back(
+                std::make_unique<ProverResponse>(ProverError::PROVER_NOT_READY));
+        }
+        return responses;
+    }
+    return impl->proveBatch(inputs, n);
+}
+
 // FULLPROVERIMPL
 
 std::string getfilename(std::string path)
@@ -132,7 +168,12 @@ std::string getfilename(std::string path)
     return path.substr(0, dot_i);
 }
 
-FullProverImpl::FullProverImpl(const char* _zkeyFileName)
+FullProverImpl::FullProverImpl(const char* _zkeyFileName,
+                               size_t      fixedBaseMemoryMB,
+                               size_t      multiexpMemoryMB,
+                               size_t      proofSlots,
+                               size_t      threadsPerSlot,
+                               bool        pinProofSlots)
 {
     std::cout << "in FullProverImpl constructor" << std::endl;
     mpz_init(altBbn128r);
@@ -171,6 +212,34 @@ FullProverImpl::FullProverImpl(const char* _zkeyFileName)
             zKey->getSectionData(8), // pointsC
             zKey->getSectionData(9)  // pointsH1
         );
+
+        log_info(std::string("Field kernels: fq ") + Fq_rawKernel() +
+                 ", fr " + Fr_rawKernel() + ", fr batch " + Fr_batchKernel());
+
+        prover->setMultiexpMemoryBudget((u_int64_t)multiexpMemoryMB << 20);
+
+        if (proofSlots > 0)
+        {
+            slots = std::make_unique<ProofSlots>(proofSlots, threadsPerSlot,
+                                                 pinProofSlots);
+            std::ostringstream ss;
+            ss << "Proof slots: " << slots->nSlots() << " of "
+               << slots->threadsPerSlot() << " threads"
+               << (pinProofSlots ? ", pinned" : "");
+            log_info(ss.str());
+        }
+
+        if (fixedBaseMemoryMB > 0)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            prover->precomputeFixedBases((u_int64_t)fixedBaseMemoryMB << 20);
+            auto end = std::chrono::high_resolution_clock::now();
+            std::cout << "Time taken for fixed base precomputation: "
+                      << std::chrono::duration_cast<std::chrono::milliseconds>(
+                             end - start)
+                             .count()
+                      << " milliseconds" << std::endl;
+        }
     }
     catch (...)
     {
@@ -222,11 +291,19 @@ ProverResponse FullProverImpl::prove(const char* witness_file_path) const
     AltBn128::FrElement* wtnsData =
         (AltBn128::FrElement*)wtns->getSectionData(2);
 
-    auto start = std::chrono::high_resolution_clock::now();
-    json proof = prover->prove(wtnsData)->toJson();
-    auto end   = std::chrono::high_resolution_clock::now();
-    auto prover_duration =
-        std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+    // Timed once in a slot, without the wait for it.
+    std::chrono::milliseconds prover_duration;
+    json                      proof = inSlot(
+        [&]
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            json p     = prover->prove(wtnsData)->toJson();
+            auto end   = std::chrono::high_resolution_clock::now();
+            prover_duration =
+                std::chrono::duration_cast<std::chrono::milliseconds>(end -
+                                                                      start);
+            return p;
+        });
     log_info("finished proof computation");
 
     {
@@ -248,6 +325,74 @@ ProverResponse FullProverImpl::prove(const char* witness_file_path) const
     return ProverResponse(proof_raw, metrics);
 }
 
+std::vector<std::unique_ptr<ProverResponse>>
+FullProverImpl::proveBatch(const char* const* witness_file_paths,
+                           size_t             n) const
+{
+    log_info("FullProverImpl::proveBatch begin");
+
+    std::vector<std::unique_ptr<ProverResponse>>        responses(n);
+    std::vector<std::unique_ptr<BinFileUtils::BinFile>> wtnss;
+    std::vector<AltBn128::FrElement*>                   wtnsData;
+    std::vector<size_t>                                 proved;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        log_debug(std::string(witness_file_paths[i]));
+
+        auto wtns = BinFileUtils::BinFile::make_from_file(
+            witness_file_paths[i], "wtns", 2);
+        auto wtnsHeader = WtnsUtils::Header::make_from_bin_file(*wtns.get());
+
+        if (mpz_cmp(wtnsHeader->prime, altBbn128r) != 0)
+        {
+            log_error("The generated witness file uses a different curve than "
+                      "bn128, which is currently the only supported curve.");
+            responses[i] = std::make_unique<ProverResponse>(
+                ProverError::WITNESS_GENERATION_INVALID_CURVE);
+            continue;
+        }
+
+        wtnsData.push_back((AltBn128::FrElement*)wtns->getSectionData(2));
+        wtnss.push_back(std::move(wtns));
+        proved.push_back(i);
+    }
+    log_info("Loaded witness files");
+
+    std::chrono::milliseconds prover_duration;
+    auto                      proofs = inSlot(
+        [&]
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            auto p = prover->proveBatch(wtnsData.data(), wtnsData.size());
+            auto end = std::chrono::high_resolution_clock::now();
+            prover_duration =
+                std::chrono::duration_cast<std::chrono::milliseconds>(end -
+                                                                      start);
+            return p;
+        });
+
+    {
+        std::stringstream ss;
+        ss << "Time taken for Groth16 prover batch of " << proofs.size()
+           << ": " << prover_duration.count() << " milliseconds";
+        log_info(ss.str().data());
+    }
+
+    ProverResponseMetrics metrics;
+    metrics.prover_time = prover_duration.count();
+
+    for (size_t j = 0; j < proofs.size(); j++)
+    {
+        const char* proof_raw = strdup(proofs[j]->toJson().dump().c_str());
+        responses[proved[j]] =
+            std::make_unique<ProverResponse>(proof_raw, metrics);
+    }
+
+    log_info("FullProverImpl::proveBatch end");
+    return responses;
+}
+
 ProverResponse::~ProverResponse()
 {
     if (raw_json != empty_string) // Was allocated by strdup(),
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstddef>
+#include <memory>
+#include <vector>
+
 class FullProverImpl;
 
 enum ProverResponseType
@@ -58,7 +62,23 @@ class FullProver
 
 public:
     FullProver() = delete;
-    FullProver(const char* _zkeyFileName);
+    // fixedBaseMemoryMB: memory that may be spent at load time on precomputed
+    // multiples of the proving key points to speed up every proof, 0 disables.
+    // multiexpMemoryMB: bound for the buckets of each multiexp of a proof,
+    // independent of the number of threads, 0 for no bound.
+    // proofSlots: number of proofs that run at once, each on its own
+    // threadsPerSlot threads (the cores split evenly when 0), the rest wait.
+    // 0 runs every call on the threads of the caller, all the cores.
+    // pinProofSlots: keeps every slot on its own cores (Linux only).
+    FullProver(const char* _zkeyFileName, size_t fixedBaseMemoryMB = 0,
+               size_t multiexpMemoryMB = 0, size_t proofSlots = 0,
+               size_t threadsPerSlot = 0, bool pinProofSlots = false);
     ~FullProver();
     ProverResponse prove(const char* input) const;
+    // Proofs of n witness files of the circuit at once, which is faster than
+    // one by one. They run in groups of a few witnesses, so that memory does
+    // not grow with n. One response per file, in order; prover_time is the
+    // time of the whole batch.
+    std::vector<std::unique_ptr<ProverResponse>>
+    proveBatch(const char* const* inputs, size_t n) const;
 };
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// Scalar decomposition for the GLV method. For an endomorphism phi of the
+// curve with phi(P) = lambda * P on the prime order subgroup,
+//
+//   k * P = k1 * P + k2 * phi(P)   where   k = k1 + k2 * lambda (mod r)
+//
+// and k1, k2 are about half the bit length of r. (a1, b1), (a2, b2) is a
+// short basis of the lattice {(x, y) : x + y * lambda = 0 (mod r)}, and
+// g1 = round(2^256 * |b2| / r), g2 = round(2^256 * |b1| / r) are used to
+// approximate the rounding of k * b2 / r and -k * b1 / r without divisions.
+struct GLVParams
+{
+    uint64_t g1[3];
+    uint64_t g2[3];
+    uint64_t a1[2];
+    uint64_t b1[2];
+    uint64_t a2[2];
+    uint64_t b2[2];
+    bool     a1Neg;
+    bool     b1Neg;
+    bool     a2Neg;
+    bool     b2Neg;
+};
+
+// BN254, lambda = 0xb3c4d79d41a917585bfc41088d8daaa78b17ea66b99c90dd
+inline const GLVParams bn254GLVParams = {
+    {0xd91d232ec7e0b3d7, 0x0000000000000002, 0x0000000000000000},
+    {0x7a7bd9d4391eb18e, 0x4ccef014a773d2cf, 0x0000000000000002},
+    {0x89d3256894d213e3, 0x0000000000000000},
+    {0x8211bbeb7d4f1128, 0x6f4d8248eeb859fc},
+    {0x0be4e1541221250b, 0x6f4d8248eeb859fd},
+    {0x89d3256894d213e3, 0x0000000000000000},
+    false,
+    true,
+    false,
+    false};
+
+namespace aptos
+{
+
+namespace glv_detail
+{
+
+// r = (a * b) >> 256, a has 4 limbs and b 3, r gets 2 limbs.
+inline void mulShr256(uint64_t r[2], const uint64_t a[4], const uint64_t b[3])
+{
+    uint64_t p[7] = {0, 0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 4; i++)
+    {
+        uint64_t carry = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned __int128 t =
+                (unsigned __int128)a[i] * b[j] + p[i + j] + carry;
+            p[i + j] = (uint64_t)t;
+            carry    = (uint64_t)(t >> 64);
+        }
+        p[i + 3] = carry;
+    }
+    r[0] = p[4];
+    r[1] = p[5];
+}
+
+// acc -= a * b (mod 2^192) when sub, acc += a * b otherwise.
+inline void mulAcc(uint64_t acc[3], const uint64_t a[2], const uint64_t b[2],
+                   bool sub)
+{
+    uint64_t p[3] = {0, 0, 0};
+    for (int i = 0; i < 2; i++)
+    {
+        uint64_t carry = 0;
+        for (int j = 0; i + j < 3 && j < 2; j++)
+        {
+            unsigned __int128 t =
+                (unsigned __int128)a[i] * b[j] + p[i + j] + carry;
+            p[i + j] = (uint64_t)t;
+            carry    = (uint64_t)(t >> 64);
+        }
+        if (i + 2 < 3)
+            p[i + 2] += carry;
+    }
+
+    unsigned __int128 c = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        if (sub)
+        {
+            unsigned __int128 t = (unsigned __int128)acc[i] - p[i] - c;
+            acc[i]              = (uint64_t)t;
+            c                   = (t >> 64) ? 1 : 0;
+        }
+        else
+        {
+            unsigned __int128 t = (unsigned __int128)acc[i] + p[i] + c;
+            acc[i]              = (uint64_t)t;
+            c                   = t >> 64;
+        }
+    }
+}
+
+// Splits the two's complement acc into its sign and magnitude, returns false
+// if the magnitude does not fit in 128 bits.
+inline bool absValue(uint64_t r[2], bool& neg, uint64_t acc[3])
+{
+    neg = acc[2] >> 63;
+    if (neg)
+    {
+        unsigned __int128 c = 1;
+        for (int i = 0; i < 3; i++)
+        {
+            unsigned __int128 t = (unsigned __int128)(~acc[i]) + c;
+            acc[i]              = (uint64_t)t;
+            c                   = t >> 64;
+        }
+    }
+    r[0] = acc[0];
+    r[1] = acc[1];
+    return acc[2] == 0;
+}
+
+} // namespace glv_detail
+
+// Decomposes the little endian scalar k of scalarSize <= 32 bytes into
+// |k1| and |k2|, 128 bits each, returning their signs in neg1 and neg2.
+// Always succeeds for k < r, larger scalars may not fit and return false.
+inline bool glvSplit(const GLVParams& params, const uint8_t* scalar,
+                     uint64_t scalarSize, uint64_t k1[2], bool& neg1,
+                     uint64_t k2[2], bool& neg2)
+{
+    using namespace glv_detail;
+
+    uint64_t k[4] = {0, 0, 0, 0};
+    memcpy(k, scalar, scalarSize);
+
+    // c1 = round(k * b2 / r), c2 = round(-k * b1 / r)
+    uint64_t c1[2];
+    uint64_t c2[2];
+    mulShr256(c1, k, params.g1);
+    mulShr256(c2, k, params.g2);
+    bool c1Neg = params.b2Neg;
+    bool c2Neg = !params.b1Neg;
+
+    // k1 = k - c1 * a1 - c2 * a2
+    uint64_t acc[3] = {k[0], k[1], k[2]};
+    mulAcc(acc, c1, params.a1, !(c1Neg ^ params.a1Neg));
+    mulAcc(acc, c2, params.a2, !(c2Neg ^ params.a2Neg));
+    bool ok = absValue(k1, neg1, acc);
+
+    // k2 = -c1 * b1 - c2 * b2
+    acc[0] = acc[1] = acc[2] = 0;
+    mulAcc(acc, c1, params.b1, !(c1Neg ^ params.b1Neg));
+    mulAcc(acc, c2, params.b2, !(c2Neg ^ params.b2Neg));
+    return absValue(k2, neg2, acc) && ok;
+}
+
+} // namespace aptos
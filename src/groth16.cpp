@@ -3,12 +3,12 @@
 #    include "logging.hpp"
 #    include "random_generator.hpp"
 #    include "scope_guard.hpp"
-#    include "spinlock.hpp"
 
-#    include <array>
 #    include <chrono>
-#    include <future>
 #    include <iostream>
+#    include <stdexcept>
+#    include <tbb/flow_graph.h>
+#    include <tbb/parallel_invoke.h>
 #    include <tbb/parallel_for.h>
 
 namespace Groth16
@@ -37,251 +37,271 @@ makeProver(std::uint32_t nVars, std::uint32_t nPublic, std::uint32_t domainSize,
         (typename Engine::G1PointAffine*)pointsH);
 }
 
+// Counting sort of the section 4 coefficients by constraint, keeping the
+// zkey order within a row, so that every row is summed by a single thread.
+// Throws on coefficients outside of the matrices.
 template <typename Engine>
-std::unique_ptr<Proof<Engine>>
-Prover<Engine>::prove(typename Engine::FrElement* wtns)
+void Prover<Engine>::buildCoefMatrices()
 {
+    CoefMatrix<Engine>* matrices[2] = {&matrixA, &matrixB};
 
-// #define DONT_USE_FUTURES // seems to be slower on both x86 and M2
-
-#    ifdef DONT_USE_FUTURES
-    // std::cout << "num variables: " << nVars << std::endl;
-    // std::cout << "domain size: " << domainSize << std::endl;
-    // std::cout << "num coeffs: " << nCoefs << std::endl;
-    LOG_TRACE("Start Multiexp A");
-    uint32_t                 sW = sizeof(wtns[0]);
-    typename Engine::G1Point pi_a;
-    E.g1.multiMulByScalar(pi_a, pointsA, (uint8_t*)wtns, sW, nVars);
-    std::ostringstream ss2;
-    ss2 << "pi_a: " << E.g1.toString(pi_a);
-    LOG_DEBUG(ss2);
-
-    LOG_TRACE("Start Multiexp B1");
-    typename Engine::G1Point pib1;
-    E.g1.multiMulByScalar(pib1, pointsB1, (uint8_t*)wtns, sW, nVars);
-    std::ostringstream ss3;
-    ss3 << "pib1: " << E.g1.toString(pib1);
-    LOG_DEBUG(ss3);
-
-    LOG_TRACE("Start Multiexp B2");
-    typename Engine::G2Point pi_b;
-    E.g2.multiMulByScalar(pi_b, pointsB2, (uint8_t*)wtns, sW, nVars);
-    std::ostringstream ss4;
-    ss4 << "pi_b: " << E.g2.toString(pi_b);
-    LOG_DEBUG(ss4);
-
-    LOG_TRACE("Start Multiexp C");
-    typename Engine::G1Point pi_c;
-    E.g1.multiMulByScalar(pi_c, pointsC,
-                          (uint8_t*)((uint64_t)wtns + (nPublic + 1) * sW), sW,
-                          nVars - nPublic - 1);
-    std::ostringstream ss5;
-    ss5 << "pi_c: " << E.g1.toString(pi_c);
-    LOG_DEBUG(ss5);
-
-#    else // use futures (for scalar multiplications)
-
-    LOG_TRACE("Start Multiexp A");
-    uint32_t                 sW = sizeof(wtns[0]);
-    typename Engine::G1Point pi_a;
-    auto                     pA_future = std::async(
-        [&]()
-        { E.g1.multiMulByScalar(pi_a, pointsA, (uint8_t*)wtns, sW, nVars); });
-
-    LOG_TRACE("Start Multiexp B1");
-    typename Engine::G1Point pib1;
-    auto                     pB1_future = std::async(
-        [&]()
-        { E.g1.multiMulByScalar(pib1, pointsB1, (uint8_t*)wtns, sW, nVars); });
-
-    LOG_TRACE("Start Multiexp B2");
-    typename Engine::G2Point pi_b;
-    auto                     pB2_future = std::async(
-        [&]()
-        { E.g2.multiMulByScalar(pi_b, pointsB2, (uint8_t*)wtns, sW, nVars); });
-
-    LOG_TRACE("Start Multiexp C");
-    typename Engine::G1Point pi_c;
-    auto                     pC_future = std::async(
-        [&]()
+    for (auto m : matrices)
+    {
+        m->rows.assign(domainSize + 1, 0);
+    }
+    for (u_int64_t i = 0; i < nCoefs; i++)
+    {
+        if (coefs[i].m > 1 || coefs[i].c >= domainSize || coefs[i].s >= nVars)
         {
-            E.g1.multiMulByScalar(
-                pi_c, pointsC, (uint8_t*)((uint64_t)wtns + (nPublic + 1) * sW),
-                sW, nVars - nPublic - 1);
-        });
-#    endif
-
-    LOG_TRACE("Start Initializing a b c A");
-    auto a = new typename Engine::FrElement[domainSize];
-    MAKE_SCOPE_EXIT(delete_a) { delete[] a; };
-
-    auto b = new typename Engine::FrElement[domainSize];
-    MAKE_SCOPE_EXIT(delete_b) { delete[] b; };
-
-    auto c = new typename Engine::FrElement[domainSize];
-    MAKE_SCOPE_EXIT(delete_c) { delete[] c; };
-
-    tbb::parallel_for(tbb::blocked_range<std::uint32_t>(0, domainSize),
-                      [&](tbb::blocked_range<std::uint32_t> range)
-                      {
-                          for (int i = range.begin(); i < range.end(); ++i)
-                          {
-                              E.fr.copy(a[i], E.fr.zero());
-                              E.fr.copy(b[i], E.fr.zero());
-                          }
-                      });
-
-    LOG_TRACE("Processing coefs");
+            throw std::invalid_argument("Invalid zkey coefficient " +
+                                        std::to_string(i));
+        }
+        matrices[coefs[i].m]->rows[coefs[i].c + 1]++;
+    }
+    for (auto m : matrices)
+    {
+        for (u_int32_t c = 0; c < domainSize; c++)
+        {
+            m->rows[c + 1] += m->rows[c];
+        }
+        m->signals.resize(m->rows[domainSize]);
+        m->values.resize(m->rows[domainSize]);
+    }
 
-    static constexpr int NUM_LOCKS = 1024;
+    std::vector<u_int64_t> next[2] = {
+        std::vector<u_int64_t>(matrixA.rows.begin(), matrixA.rows.end() - 1),
+        std::vector<u_int64_t>(matrixB.rows.begin(), matrixB.rows.end() - 1)};
 
-    std::array<aptos::spinlock, NUM_LOCKS> spinlocks;
+    for (u_int64_t i = 0; i < nCoefs; i++)
+    {
+        CoefMatrix<Engine>& m = *matrices[coefs[i].m];
+        u_int64_t           j = next[coefs[i].m][coefs[i].c]++;
+        m.signals[j]          = coefs[i].s;
+        E.fr.copy(m.values[j], coefs[i].coef);
+    }
+}
 
+// r[c] = sum(matrix[c][j] * wtns[j]) for all the constraints c.
+template <typename Engine>
+void Prover<Engine>::evalCoefMatrix(typename Engine::FrElement* r,
+                                    CoefMatrix<Engine>&         matrix,
+                                    typename Engine::FrElement* wtns)
+{
     tbb::parallel_for(
-        tbb::blocked_range<std::uint64_t>(0, nCoefs),
-        [&](tbb::blocked_range<std::uint64_t> range)
+        tbb::blocked_range<std::uint32_t>(0, domainSize),
+        [&](auto range)
         {
-            for (int i = range.begin(); i < range.end(); ++i)
+            for (auto c = range.begin(); c < range.end(); ++c)
             {
-                typename Engine::FrElement* ab = (coefs[i].m == 0) ? a : b;
-                typename Engine::FrElement  aux;
+                typename Engine::FrElement acc;
+                typename Engine::FrElement aux;
 
-                E.fr.mul(aux, wtns[coefs[i].s], coefs[i].coef);
+                E.fr.copy(acc, E.fr.zero());
+                for (u_int64_t j = matrix.rows[c]; j < matrix.rows[c + 1]; j++)
                 {
-                    std::unique_lock lock(spinlocks[coefs[i].c % NUM_LOCKS]);
-                    E.fr.add(ab[coefs[i].c], ab[coefs[i].c], aux);
+                    E.fr.mul(aux, wtns[matrix.signals[j]], matrix.values[j]);
+                    E.fr.add(acc, acc, aux);
                 }
+                E.fr.copy(r[c], acc);
             }
         });
+}
 
-    LOG_TRACE("Calculating c");
+template <typename Engine>
+void Prover<Engine>::precomputeFixedBases(u_int64_t maxMemory)
+{
+    u_int64_t bytesPerCopy =
+        sizeof(typename Engine::G1PointAffine) *
+            (2 * (u_int64_t)nVars + (nVars - nPublic - 1) + domainSize) +
+        sizeof(typename Engine::G2PointAffine) * nVars;
+    u_int64_t maxCopies = 1 + maxMemory / bytesPerCopy;
+    if (maxCopies <= 1)
+        return;
+
+    uint32_t sW = sizeof(typename Engine::FrElement);
+
+    tableA  = std::make_unique<FixedBaseTable<typename Engine::G1>>();
+    tableB1 = std::make_unique<FixedBaseTable<typename Engine::G1>>();
+    tableB2 = std::make_unique<FixedBaseTable<typename Engine::G2>>();
+    tableC  = std::make_unique<FixedBaseTable<typename Engine::G1>>();
+    tableH  = std::make_unique<FixedBaseTable<typename Engine::G1>>();
+
+    E.g1.precomputeBases(*tableA, pointsA, sW, nVars, maxCopies);
+    E.g1.precomputeBases(*tableB1, pointsB1, sW, nVars, maxCopies);
+    E.g2.precomputeBases(*tableB2, pointsB2, sW, nVars, maxCopies);
+    E.g1.precomputeBases(*tableC, pointsC, sW, nVars - nPublic - 1, maxCopies);
+    E.g1.precomputeBases(*tableH, pointsH, sW, domainSize, maxCopies);
+}
 
-    tbb::parallel_for(tbb::blocked_range<std::uint32_t>(0, domainSize),
-                      [&](auto range)
-                      {
-                          for (int i = range.begin(); i < range.end(); ++i)
-                          {
-                              E.fr.mul(c[i], a[i], b[i]);
-                          }
-                      });
+template <typename Engine>
+template <typename Curve>
+void Prover<Engine>::multiexp(Curve& g, typename Curve::Point& r,
+                              std::unique_ptr<FixedBaseTable<Curve>>& table,
+                              typename Curve::PointAffine* points,
+                              uint8_t* scalars, u_int32_t n,
+                              MultiexpWorkspace& ws)
+{
+    if (table)
+    {
+        g.multiMulByScalar(r, *table, scalars, &ws);
+    }
+    else
+    {
+        g.multiMulByScalar(r, points, scalars,
+                           sizeof(typename Engine::FrElement), n, 0, &ws);
+    }
+}
 
-    LOG_TRACE("Initializing fft");
-    std::uint32_t domainPower = fft_.log2(domainSize);
+template <typename Engine>
+template <typename Curve>
+void Prover<Engine>::multiexp(Curve& g, typename Curve::Point& r,
+                              std::unique_ptr<FixedBaseTable<Curve>>& table,
+                              typename Curve::PointAffine* points,
+                              ScalarPlan& plan, u_int32_t offset, u_int32_t n,
+                              MultiexpWorkspace& ws)
+{
+    if (table)
+    {
+        g.multiMulByScalar(r, *table, plan, offset, &ws);
+    }
+    else
+    {
+        g.multiMulByScalar(r, points, plan, offset, n, &ws);
+    }
+}
 
-    auto iFFT_A_future = std::async(
-        [&]()
-        {
-            LOG_TRACE("Start iFFT A");
-            fft_.ifft(a, domainSize);
-            LOG_TRACE("a After ifft:");
-            LOG_DEBUG(E.fr.toString(a[0]).c_str());
-            LOG_DEBUG(E.fr.toString(a[1]).c_str());
-            LOG_TRACE("Start Shift A");
-
-            tbb::parallel_for(
-                tbb::blocked_range<std::uint32_t>(0, domainSize),
-                [&](auto range)
-                {
-                    for (int i = range.begin(); i < range.end(); ++i)
-                    {
-                        E.fr.mul(a[i], a[i], fft_.root(domainPower + 1, i));
-                    }
-                });
-            LOG_TRACE("a After shift:");
-            LOG_DEBUG(E.fr.toString(a[0]).c_str());
-            LOG_DEBUG(E.fr.toString(a[1]).c_str());
-            LOG_TRACE("Start FFT A");
-            fft_.fft(a, domainSize);
-            LOG_TRACE("a After fft:");
-            LOG_DEBUG(E.fr.toString(a[0]).c_str());
-            LOG_DEBUG(E.fr.toString(a[1]).c_str());
-        });
+template <typename Engine>
+void Prover<Engine>::setMultiexpMemoryBudget(u_int64_t bytes)
+{
+    std::lock_guard<std::mutex> guard(workspacesLock);
+    multiexpMemoryBudget = bytes;
+}
 
-    auto iFFT_B_future = std::async(
-        [&]()
+template <typename Engine>
+std::unique_ptr<ProverWorkspace<Engine>> Prover<Engine>::acquireWorkspace()
+{
+    std::unique_ptr<ProverWorkspace<Engine>> ws;
+    u_int64_t                                budget;
+    {
+        std::lock_guard<std::mutex> guard(workspacesLock);
+        if (!workspaces.empty())
         {
-            LOG_TRACE("Start iFFT B");
-            fft_.ifft(b, domainSize);
-            LOG_TRACE("b After ifft:");
-            LOG_DEBUG(E.fr.toString(b[0]).c_str());
-            LOG_DEBUG(E.fr.toString(b[1]).c_str());
-            LOG_TRACE("Start Shift B");
-            // #    pragma omp parallel for
-            //     for (std::uint64_t i = 0; i < domainSize; i++)
-            tbb::parallel_for(
-                tbb::blocked_range<std::uint32_t>(0, domainSize),
-                [&](auto range)
-                {
-                    for (int i = range.begin(); i < range.end(); ++i)
-                    {
-                        E.fr.mul(b[i], b[i], fft_.root(domainPower + 1, i));
-                    }
-                });
-            LOG_TRACE("b After shift:");
-            LOG_DEBUG(E.fr.toString(b[0]).c_str());
-            LOG_DEBUG(E.fr.toString(b[1]).c_str());
-            LOG_TRACE("Start FFT B");
-            fft_.fft(b, domainSize);
-            LOG_TRACE("b After fft:");
-            LOG_DEBUG(E.fr.toString(b[0]).c_str());
-            LOG_DEBUG(E.fr.toString(b[1]).c_str());
-        });
+            ws = std::move(workspaces.back());
+            workspaces.pop_back();
+        }
+        budget = multiexpMemoryBudget;
+    }
+    if (!ws)
+        ws = std::make_unique<ProverWorkspace<Engine>>();
 
-    auto iFFT_C_future = std::async(
-        [&]()
-        {
-            LOG_TRACE("Start iFFT C");
-            fft_.ifft(c, domainSize);
-            LOG_TRACE("c After ifft:");
-            LOG_DEBUG(E.fr.toString(c[0]).c_str());
-            LOG_DEBUG(E.fr.toString(c[1]).c_str());
-            LOG_TRACE("Start Shift C");
-
-            tbb::parallel_for(
-                tbb::blocked_range<std::uint32_t>(0, domainSize),
-                [&](auto range)
-                {
-                    for (int i = range.begin(); i < range.end(); ++i)
-                    {
-                        E.fr.mul(c[i], c[i], fft_.root(domainPower + 1, i));
-                    }
-                });
-            LOG_TRACE("c After shift:");
-            LOG_DEBUG(E.fr.toString(c[0]).c_str());
-            LOG_DEBUG(E.fr.toString(c[1]).c_str());
-            LOG_TRACE("Start FFT C");
-            fft_.fft(c, domainSize);
-            LOG_TRACE("c After fft:");
-            LOG_DEBUG(E.fr.toString(c[0]).c_str());
-            LOG_DEBUG(E.fr.toString(c[1]).c_str());
-        });
+    for (MultiexpWorkspace* msm :
+         {&ws->msmA, &ws->msmB1, &ws->msmB2, &ws->msmC, &ws->msmH})
+        msm->memoryBudget = budget;
+    return ws;
+}
+
+template <typename Engine>
+void Prover<Engine>::releaseWorkspace(
+    std::unique_ptr<ProverWorkspace<Engine>> ws)
+{
+    std::lock_guard<std::mutex> guard(workspacesLock);
+    workspaces.push_back(std::move(ws));
+}
+
+template <typename Engine>
+template <typename Curve>
+void Prover<Engine>::multiexp(Curve& g, typename Curve::Point* r,
+                              std::unique_ptr<FixedBaseTable<Curve>>& table,
+                              typename Curve::PointAffine* points,
+                              ScalarPlan** plans, u_int32_t nPlans,
+                              u_int32_t offset, u_int32_t n,
+                              MultiexpWorkspace& ws)
+{
+    if (table)
+    {
+        g.multiMulByScalar(r, *table, plans, nPlans, offset, &ws);
+    }
+    else
+    {
+        g.multiMulByScalar(r, points, plans, nPlans, offset, n, &ws);
+    }
+}
 
-    iFFT_A_future.get();
-    iFFT_B_future.get();
-    iFFT_C_future.get();
+// Plan for the multiexps with table, which needs its window sizes.
+template <typename Engine>
+template <typename Curve>
+void Prover<Engine>::planScalars(Curve& g, ScalarPlan& plan,
+                                 std::unique_ptr<FixedBaseTable<Curve>>& table,
+                                 typename Engine::FrElement* scalars,
+                                 u_int32_t n, MultiexpWorkspace& ws)
+{
+    if (table)
+    {
+        g.planScalars(plan, (uint8_t*)scalars, sizeof(scalars[0]), n,
+                      table->bitsPerChunk,
+                      table->nCopies() * table->chunksPerCopy, &ws);
+    }
+    else
+    {
+        g.planScalars(plan, (uint8_t*)scalars, sizeof(scalars[0]), n, 0, 0,
+                      &ws);
+    }
+}
 
-    LOG_TRACE("Start ABC");
+// The scalars of the H multiexp, left in a. a, b and c go to the coset
+// together, through the same stages. The last stage of the FFT directly
+// computes a * b - c.
+template <typename Engine>
+void Prover<Engine>::computeH(typename Engine::FrElement* a,
+                              typename Engine::FrElement* b,
+                              typename Engine::FrElement* c,
+                              typename Engine::FrElement* wtns)
+{
+    LOG_TRACE("Processing coefs");
+    tbb::parallel_invoke([&] { evalCoefMatrix(a, matrixA, wtns); },
+                         [&] { evalCoefMatrix(b, matrixB, wtns); });
 
+    LOG_TRACE("Calculating c");
     tbb::parallel_for(tbb::blocked_range<std::uint32_t>(0, domainSize),
                       [&](auto range)
                       {
-                          for (int i = range.begin(); i < range.end(); ++i)
-                          {
-                              E.fr.mul(a[i], a[i], b[i]);
-                              E.fr.sub(a[i], a[i], c[i]);
-                              E.fr.fromMontgomery(a[i], a[i]);
-                          }
+                          Fr_rawMMulBatch(c + range.begin(), a + range.begin(),
+                                          b + range.begin(), range.size());
                       });
 
+    typename Engine::FrElement* abc[] = {a, b, c};
+
+    LOG_TRACE("Start iFFT ABC");
+    fft_.ifftCosetDifBatch(abc, 3, domainSize);
+
+    LOG_TRACE("Start FFT ABC");
+    fft_.fftDitBatch(abc, 3, domainSize,
+                     [&](std::uint64_t i)
+                     {
+                         E.fr.mul(a[i], a[i], b[i]);
+                         E.fr.sub(a[i], a[i], c[i]);
+                         E.fr.fromMontgomery(a[i], a[i]);
+                     });
+
     LOG_TRACE("abc:");
     LOG_DEBUG(E.fr.toString(a[0]).c_str());
     LOG_DEBUG(E.fr.toString(a[1]).c_str());
+}
 
-    LOG_TRACE("Start Multiexp H");
-    typename Engine::G1Point pih;
-    E.g1.multiMulByScalar(pih, pointsH, (uint8_t*)a, sizeof(a[0]), domainSize);
+// Adds the verification key terms and the random shifts r and s to the
+// multiexps of a proof.
+template <typename Engine>
+std::unique_ptr<Proof<Engine>>
+Prover<Engine>::finishProof(typename Engine::G1Point& pi_a,
+                            typename Engine::G1Point& pib1,
+                            typename Engine::G2Point& pi_b,
+                            typename Engine::G1Point& pi_c,
+                            typename Engine::G1Point& pih)
+{
     std::ostringstream ss1;
-    ss1 << "pih: " << E.g1.toString(pih);
+    ss1 << "pi_a: " << E.g1.toString(pi_a) << ", pib1: " << E.g1.toString(pib1)
+        << ", pi_b: " << E.g2.toString(pi_b) << ", pi_c: "
+        << E.g1.toString(pi_c) << ", pih: " << E.g1.toString(pih);
     LOG_DEBUG(ss1);
 
     typename Engine::FrElement r;
@@ -314,13 +334,6 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
         cmp              = mpn_cmp(s_copy, fr_mod_copy, Fr_N64);
     }
 
-#    ifndef DONT_USE_FUTURES
-    pA_future.get();
-    pB1_future.get();
-    pB2_future.get();
-    pC_future.get();
-#    endif
-
     typename Engine::G1Point p1;
     typename Engine::G2Point p2;
 
@@ -358,6 +371,270 @@ Prover<Engine>::prove(typename Engine::FrElement* wtns)
     return p;
 }
 
+template <typename Engine>
+std::unique_ptr<Proof<Engine>>
+Prover<Engine>::prove(typename Engine::FrElement* wtns)
+{
+    // Declared first, so that it is only released once the tasks that use
+    // it are done, even when unwinding.
+    auto ws = acquireWorkspace();
+    MAKE_SCOPE_EXIT(release_ws) { releaseWorkspace(std::move(ws)); };
+
+    auto a = ws->abc.template get<typename Engine::FrElement>(
+        3 * (uint64_t)domainSize);
+    auto b = a + domainSize;
+    auto c = b + domainSize;
+
+    typename Engine::G1Point pi_a;
+    typename Engine::G1Point pib1;
+    typename Engine::G2Point pi_b;
+    typename Engine::G1Point pi_c;
+    typename Engine::G1Point pih;
+
+    // The proof runs as a graph of tasks on the TBB workers, each task
+    // spreading over them with its own parallel loops. The G2 multiexp and
+    // the chain from the coefficients through the FFTs to the H multiexp
+    // are the longest paths, so their tasks are taken first.
+    typedef tbb::flow::continue_node<tbb::flow::continue_msg> Node;
+    typedef const tbb::flow::continue_msg&                    Msg;
+    const tbb::flow::node_priority_t criticalPath = 1;
+
+    tbb::flow::graph graph;
+
+    // Window digits of the witness, shared by the A, B1, B2 and C multiexps.
+    Node plan(graph,
+              [&](Msg)
+              {
+                  LOG_TRACE("Start Scalar Plan");
+                  planScalars(E.g1, ws->plan, tableA, wtns, nVars, ws->msmA);
+              });
+
+    Node multiexpA(graph,
+                   [&](Msg)
+                   {
+                       LOG_TRACE("Start Multiexp A");
+                       multiexp(E.g1, pi_a, tableA, pointsA, ws->plan, 0, nVars,
+                                ws->msmA);
+                   });
+
+    Node multiexpB1(graph,
+                    [&](Msg)
+                    {
+                        LOG_TRACE("Start Multiexp B1");
+                        multiexp(E.g1, pib1, tableB1, pointsB1, ws->plan, 0,
+                                 nVars, ws->msmB1);
+                    });
+
+    Node multiexpB2(
+        graph,
+        [&](Msg)
+        {
+            LOG_TRACE("Start Multiexp B2");
+            multiexp(E.g2, pi_b, tableB2, pointsB2, ws->plan, 0, nVars,
+                     ws->msmB2);
+        },
+        criticalPath);
+
+    Node multiexpC(graph,
+                   [&](Msg)
+                   {
+                       LOG_TRACE("Start Multiexp C");
+                       multiexp(E.g1, pi_c, tableC, pointsC, ws->plan,
+                                nPublic + 1, nVars - nPublic - 1, ws->msmC);
+                   });
+
+    Node abc(graph, [&](Msg) { computeH(a, b, c, wtns); }, criticalPath);
+
+    Node multiexpH(
+        graph,
+        [&](Msg)
+        {
+            LOG_TRACE("Start Multiexp H");
+            multiexp(E.g1, pih, tableH, pointsH, (uint8_t*)a, domainSize,
+                     ws->msmH);
+        },
+        criticalPath);
+
+    tbb::flow::make_edge(plan, multiexpA);
+    tbb::flow::make_edge(plan, multiexpB1);
+    tbb::flow::make_edge(plan, multiexpB2);
+    tbb::flow::make_edge(plan, multiexpC);
+    tbb::flow::make_edge(abc, multiexpH);
+
+    plan.try_put(tbb::flow::continue_msg());
+    abc.try_put(tbb::flow::continue_msg());
+    graph.wait_for_all();
+
+    return finishProof(pi_a, pib1, pi_b, pi_c, pih);
+}
+
+// prove() for several witnesses at once, in groups of up to
+// GROTH16_MAX_BATCH_SIZE that reuse the same workspaces.
+template <typename Engine>
+std::vector<std::unique_ptr<Proof<Engine>>>
+Prover<Engine>::proveBatch(typename Engine::FrElement** wtns, u_int32_t n)
+{
+    std::vector<std::unique_ptr<Proof<Engine>>> proofs;
+    if (n == 0)
+        return proofs;
+
+    u_int32_t groupSize = std::min<u_int32_t>(n, GROTH16_MAX_BATCH_SIZE);
+
+    std::vector<std::unique_ptr<ProverWorkspace<Engine>>> wss;
+    MAKE_SCOPE_EXIT(release_wss)
+    {
+        for (auto& ws : wss)
+            releaseWorkspace(std::move(ws));
+    };
+    for (u_int32_t i = 0; i < groupSize; i++)
+        wss.push_back(acquireWorkspace());
+
+    for (u_int32_t i = 0; i < n; i += groupSize)
+        proveGroup(wtns + i, std::min(groupSize, n - i), wss.data(), proofs);
+    return proofs;
+}
+
+// Proofs of a group of proveBatch(), appended to proofs. Each multiexp runs
+// once for all of the witnesses, reading its bases once, and with the
+// buckets of the first workspace, k times those of a single proof for a
+// group of k. The H multiexp needs plans of its scalars for that. Every
+// witness keeps its own a, b, c and plans in its workspace.
+template <typename Engine>
+void Prover<Engine>::proveGroup(
+    typename Engine::FrElement** wtns, u_int32_t n,
+    std::unique_ptr<ProverWorkspace<Engine>>*    wss,
+    std::vector<std::unique_ptr<Proof<Engine>>>& proofs)
+{
+    std::vector<typename Engine::FrElement*> a(n);
+    std::vector<ScalarPlan*>                 plans(n);
+    std::vector<ScalarPlan*>                 plansH(n);
+    for (u_int32_t i = 0; i < n; i++)
+    {
+        a[i] = wss[i]->abc.template get<typename Engine::FrElement>(
+            3 * (uint64_t)domainSize);
+        plans[i]  = &wss[i]->plan;
+        plansH[i] = &wss[i]->planH;
+    }
+
+    std::vector<typename Engine::G1Point> pi_a(n);
+    std::vector<typename Engine::G1Point> pib1(n);
+    std::vector<typename Engine::G2Point> pi_b(n);
+    std::vector<typename Engine::G1Point> pi_c(n);
+    std::vector<typename Engine::G1Point> pih(n);
+
+    // The graph of prove() with the plans and H scalars of every witness
+    // feeding the same multiexp nodes.
+    typedef tbb::flow::continue_node<tbb::flow::continue_msg> Node;
+    typedef const tbb::flow::continue_msg&                    Msg;
+    const tbb::flow::node_priority_t criticalPath = 1;
+
+    tbb::flow::graph graph;
+
+    MultiexpWorkspace& msmA  = wss[0]->msmA;
+    MultiexpWorkspace& msmB1 = wss[0]->msmB1;
+    MultiexpWorkspace& msmB2 = wss[0]->msmB2;
+    MultiexpWorkspace& msmC  = wss[0]->msmC;
+    MultiexpWorkspace& msmH  = wss[0]->msmH;
+
+    Node multiexpA(graph,
+                   [&](Msg)
+                   {
+                       LOG_TRACE("Start Multiexp A");
+                       multiexp(E.g1, pi_a.data(), tableA, pointsA,
+                                plans.data(), n, 0, nVars, msmA);
+                   });
+
+    Node multiexpB1(graph,
+                    [&](Msg)
+                    {
+                        LOG_TRACE("Start Multiexp B1");
+                        multiexp(E.g1, pib1.data(), tableB1, pointsB1,
+                                 plans.data(), n, 0, nVars, msmB1);
+                    });
+
+    Node multiexpB2(
+        graph,
+        [&](Msg)
+        {
+            LOG_TRACE("Start Multiexp B2");
+            multiexp(E.g2, pi_b.data(), tableB2, pointsB2, plans.data(), n, 0,
+                     nVars, msmB2);
+        },
+        criticalPath);
+
+    Node multiexpC(graph,
+                   [&](Msg)
+                   {
+                       LOG_TRACE("Start Multiexp C");
+                       multiexp(E.g1, pi_c.data(), tableC, pointsC,
+                                plans.data(), n, nPublic + 1,
+                                nVars - nPublic - 1, msmC);
+                   });
+
+    Node multiexpH(
+        graph,
+        [&](Msg)
+        {
+            LOG_TRACE("Start Multiexp H");
+            multiexp(E.g1, pih.data(), tableH, pointsH, plansH.data(), n, 0,
+                     domainSize, msmH);
+        },
+        criticalPath);
+
+    std::vector<std::unique_ptr<Node>> nodes;
+    for (u_int32_t i = 0; i < n; i++)
+    {
+        auto plan = std::make_unique<Node>(
+            graph, [&, i](Msg)
+            {
+                planScalars(E.g1, *plans[i], tableA, wtns[i], nVars,
+                            wss[i]->msmA);
+            });
+
+        auto abc = std::make_unique<Node>(
+            graph,
+            [&, i](Msg)
+            {
+                computeH(a[i], a[i] + domainSize, a[i] + 2 * domainSize,
+                         wtns[i]);
+            },
+            criticalPath);
+
+        auto planH = std::make_unique<Node>(
+            graph,
+            [&, i](Msg)
+            {
+                planScalars(E.g1, *plansH[i], tableH, a[i], domainSize,
+                            wss[i]->msmH);
+            },
+            criticalPath);
+
+        tbb::flow::make_edge(*plan, multiexpA);
+        tbb::flow::make_edge(*plan, multiexpB1);
+        tbb::flow::make_edge(*plan, multiexpB2);
+        tbb::flow::make_edge(*plan, multiexpC);
+        tbb::flow::make_edge(*abc, *planH);
+        tbb::flow::make_edge(*planH, multiexpH);
+
+        nodes.push_back(std::move(plan));
+        nodes.push_back(std::move(abc));
+        nodes.push_back(std::move(planH));
+    }
+
+    for (u_int32_t i = 0; i < n; i++)
+    {
+        nodes[3 * i]->try_put(tbb::flow::continue_msg());
+        nodes[3 * i + 1]->try_put(tbb::flow::continue_msg());
+    }
+    graph.wait_for_all();
+
+    for (u_int32_t i = 0; i < n; i++)
+    {
+        proofs.push_back(
+            finishProof(pi_a[i], pib1[i], pi_b[i], pi_c[i], pih[i]));
+    }
+}
+
 template <typename Engine>
 std::string Proof<Engine>::toJsonStr()
 {
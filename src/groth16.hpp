@@ -1,13 +1,23 @@
 #ifndef GROTH16_HPP
 #define GROTH16_HPP
 
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <sstream>
 #include <string>
+#include <vector>
 
 using json = nlohmann::json;
 
+// Largest number of witnesses that proveBatch() proves at once. The buckets
+// of the multiexps and the workspaces of a batch grow with it.
+#ifndef GROTH16_MAX_BATCH_SIZE
+#    define GROTH16_MAX_BATCH_SIZE 4
+#endif
+
 #include "fft.hpp"
+#include "multiexp.hpp"
+#include "workspace.hpp"
 
 namespace Groth16
 {
@@ -41,6 +51,31 @@ struct Coef
 };
 #pragma pack(pop)
 
+// Coefficients of one of the A and B matrices grouped by constraint, row c
+// holds the entries [rows[c], rows[c + 1]) of signals and values.
+template <typename Engine>
+struct CoefMatrix
+{
+    std::vector<u_int64_t>                  rows;
+    std::vector<u_int32_t>                  signals;
+    std::vector<typename Engine::FrElement> values;
+};
+
+// Buffers of one proof in flight. The Prover keeps them between proofs, so
+// that they are mapped and faulted in by the first proof only.
+template <typename Engine>
+struct ProverWorkspace
+{
+    WorkspaceBuffer   abc; // a, b and c, domainSize elements each
+    ScalarPlan        plan;
+    ScalarPlan        planH; // of the H scalars, for proveBatch()
+    MultiexpWorkspace msmA;
+    MultiexpWorkspace msmB1;
+    MultiexpWorkspace msmB2;
+    MultiexpWorkspace msmC;
+    MultiexpWorkspace msmH;
+};
+
 template <typename Engine>
 class Prover
 {
@@ -56,6 +91,8 @@ class Prover
     typename Engine::G1PointAffine& vk_delta1;
     typename Engine::G2PointAffine& vk_delta2;
     Coef<Engine>*                   coefs;
+    CoefMatrix<Engine>              matrixA;
+    CoefMatrix<Engine>              matrixB;
     typename Engine::G1PointAffine* pointsA;
     typename Engine::G1PointAffine* pointsB1;
     typename Engine::G2PointAffine* pointsB2;
@@ -64,6 +101,59 @@ class Prover
 
     FFT<typename Engine::Fr> fft_;
 
+    std::unique_ptr<FixedBaseTable<typename Engine::G1>> tableA;
+    std::unique_ptr<FixedBaseTable<typename Engine::G1>> tableB1;
+    std::unique_ptr<FixedBaseTable<typename Engine::G2>> tableB2;
+    std::unique_ptr<FixedBaseTable<typename Engine::G1>> tableC;
+    std::unique_ptr<FixedBaseTable<typename Engine::G1>> tableH;
+
+    // Idle workspaces, one is taken by every proof in flight.
+    std::mutex                                            workspacesLock;
+    std::vector<std::unique_ptr<ProverWorkspace<Engine>>> workspaces;
+    u_int64_t multiexpMemoryBudget; // guarded by workspacesLock
+
+    std::unique_ptr<ProverWorkspace<Engine>> acquireWorkspace();
+    void releaseWorkspace(std::unique_ptr<ProverWorkspace<Engine>> ws);
+
+    void buildCoefMatrices();
+    void evalCoefMatrix(typename Engine::FrElement* r,
+                        CoefMatrix<Engine>&         matrix,
+                        typename Engine::FrElement* wtns);
+
+    template <typename Curve>
+    void multiexp(Curve& g, typename Curve::Point& r,
+                  std::unique_ptr<FixedBaseTable<Curve>>& table,
+                  typename Curve::PointAffine* points, uint8_t* scalars,
+                  u_int32_t n, MultiexpWorkspace& ws);
+    template <typename Curve>
+    void multiexp(Curve& g, typename Curve::Point& r,
+                  std::unique_ptr<FixedBaseTable<Curve>>& table,
+                  typename Curve::PointAffine* points, ScalarPlan& plan,
+                  u_int32_t offset, u_int32_t n, MultiexpWorkspace& ws);
+    template <typename Curve>
+    void multiexp(Curve& g, typename Curve::Point* r,
+                  std::unique_ptr<FixedBaseTable<Curve>>& table,
+                  typename Curve::PointAffine* points, ScalarPlan** plans,
+                  u_int32_t nPlans, u_int32_t offset, u_int32_t n,
+                  MultiexpWorkspace& ws);
+    template <typename Curve>
+    void planScalars(Curve& g, ScalarPlan& plan,
+                     std::unique_ptr<FixedBaseTable<Curve>>& table,
+                     typename Engine::FrElement* scalars, u_int32_t n,
+                     MultiexpWorkspace& ws);
+
+    void computeH(typename Engine::FrElement* a, typename Engine::FrElement* b,
+                  typename Engine::FrElement* c,
+                  typename Engine::FrElement* wtns);
+    void proveGroup(typename Engine::FrElement** wtns, u_int32_t n,
+                    std::unique_ptr<ProverWorkspace<Engine>>*    wss,
+                    std::vector<std::unique_ptr<Proof<Engine>>>& proofs);
+    std::unique_ptr<Proof<Engine>> finishProof(typename Engine::G1Point& pi_a,
+                                               typename Engine::G1Point& pib1,
+                                               typename Engine::G2Point& pi_b,
+                                               typename Engine::G1Point& pi_c,
+                                               typename Engine::G1Point& pih);
+
 public:
     Prover(Engine& _E, u_int32_t _nVars, u_int32_t _nPublic,
            u_int32_t _domainSize, u_int64_t _nCoefs,
@@ -94,7 +184,9 @@ public:
         , pointsC(_pointsC)
         , pointsH(_pointsH)
         , fft_(domainSize * 2)
+        , multiexpMemoryBudget(0)
     {
+        buildCoefMatrices();
     }
 
     Prover() = delete;
@@ -102,7 +194,20 @@ public:
     Prover(Prover const&)            = delete;
     Prover& operator=(Prover const&) = delete;
 
+    // Trades up to maxMemory bytes for shifted copies of the proving key
+    // points, so that the multiexps of every proof run fewer windows.
+    void precomputeFixedBases(u_int64_t maxMemory);
+
+    // Upper bound in bytes for the buckets of each multiexp of the proofs
+    // that start after the call, 0 for none.
+    void setMultiexpMemoryBudget(u_int64_t bytes);
+
     std::unique_ptr<Proof<Engine>> prove(typename Engine::FrElement* wtns);
+
+    // Proofs of n witnesses of the circuit, sharing the reads of the bases
+    // and the multiexp buffers within groups of GROTH16_MAX_BATCH_SIZE.
+    std::vector<std::unique_ptr<Proof<Engine>>>
+    proveBatch(typename Engine::FrElement** wtns, u_int32_t n);
 };
 
 template <typename Engine>
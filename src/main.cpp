@@ -1,12 +1,14 @@
 #include "fullprover.hpp"
 #include <iostream>
+#include <string>
 
 int main(int argc, char* argv[])
 {
     auto zkey_file = argc > 1 ? argv[1] : "./testdata/circuit_final.zkey";
     auto wtns_file = argc > 2 ? argv[2] : "./witness.wtns";
+    auto fixed_base_mb = argc > 3 ? std::stoul(argv[3]) : 0;
 
-    FullProver prover(zkey_file);
+    FullProver prover(zkey_file, fixed_base_mb);
 
     while (1)
     {
@@ -0,0 +1,455 @@
+#ifndef MONT_FIELD_HPP
+#define MONT_FIELD_HPP
+
+#include <gmp.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+// Montgomery arithmetic over a 4 limb prime known at compile time, header
+// only, so that whole formulas over it compile into straight line code.
+// Params provides q as `static constexpr std::uint64_t q[4]`, least
+// significant limb first; every other constant is derived from it at
+// compile time. Same interface and Montgomery form, R = 2^256, as the
+// generated RawFq and RawFr, so MontField can stand in for them as the
+// Field of Curve, F2Field and FFT.
+
+namespace MontFieldDetail
+{
+
+typedef unsigned __int128 u128;
+
+struct Limbs
+{
+    std::uint64_t v[4];
+};
+
+// -1/q mod 2^64, by Newton iteration.
+constexpr std::uint64_t negInverse(std::uint64_t q0)
+{
+    std::uint64_t inv = 1;
+    for (int i = 0; i < 6; i++)
+    {
+        inv *= 2 - q0 * inv;
+    }
+    return 0 - inv;
+}
+
+constexpr int bitLength(const std::uint64_t* q)
+{
+    int bits = 256;
+    while (bits > 0 && !(q[(bits - 1) / 64] >> ((bits - 1) % 64) & 1))
+    {
+        bits--;
+    }
+    return bits;
+}
+
+// 2^k mod q, by doubling.
+constexpr Limbs powTwo(const std::uint64_t* q, int k)
+{
+    Limbs r = {{1, 0, 0, 0}};
+    for (int i = 0; i < k; i++)
+    {
+        Limbs         s     = {};
+        std::uint64_t carry = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            s.v[j] = (r.v[j] << 1) | carry;
+            carry  = r.v[j] >> 63;
+        }
+        Limbs         d      = {};
+        std::uint64_t borrow = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            u128 t = (u128)s.v[j] - q[j] - borrow;
+            d.v[j] = (std::uint64_t)t;
+            borrow = (std::uint64_t)(t >> 64) & 1;
+        }
+        r = (carry || !borrow) ? d : s;
+    }
+    return r;
+}
+
+} // namespace MontFieldDetail
+
+template <typename Params>
+class MontField
+{
+    typedef MontFieldDetail::u128 u128;
+
+public:
+    const static int N64     = 4;
+    const static int MaxBits = MontFieldDetail::bitLength(Params::q);
+
+    struct Element
+    {
+        std::uint64_t v[N64];
+    };
+
+private:
+    static constexpr const std::uint64_t* q = Params::q;
+    static constexpr std::uint64_t np = MontFieldDetail::negInverse(q[0]);
+    static constexpr MontFieldDetail::Limbs R1 =
+        MontFieldDetail::powTwo(q, 256);
+    static constexpr MontFieldDetail::Limbs R2 =
+        MontFieldDetail::powTwo(q, 512);
+    static constexpr MontFieldDetail::Limbs R3 =
+        MontFieldDetail::powTwo(q, 768);
+
+    Element fZero;
+    Element fOne;
+    Element fNegOne;
+
+    // r = s - q if s >= q, with carry the bit above s.
+    static inline void reduce(std::uint64_t r[N64], const std::uint64_t s[N64],
+                              std::uint64_t carry)
+    {
+        std::uint64_t d[N64];
+        std::uint64_t borrow = 0;
+        for (int j = 0; j < N64; j++)
+        {
+            u128 t = (u128)s[j] - q[j] - borrow;
+            d[j]   = (std::uint64_t)t;
+            borrow = (std::uint64_t)(t >> 64) & 1;
+        }
+        std::uint64_t keep = 0 - (std::uint64_t)(borrow & (carry ^ 1));
+        for (int j = 0; j < N64; j++)
+        {
+            r[j] = (s[j] & keep) | (d[j] & ~keep);
+        }
+    }
+
+    // Coarsely integrated operand scanning.
+    static inline void mulRaw(std::uint64_t r[N64], const std::uint64_t a[N64],
+                              const std::uint64_t b[N64])
+    {
+        std::uint64_t t[N64 + 2] = {};
+        for (int i = 0; i < N64; i++)
+        {
+            std::uint64_t carry = 0;
+            for (int j = 0; j < N64; j++)
+            {
+                u128 p = (u128)a[j] * b[i] + t[j] + carry;
+                t[j]   = (std::uint64_t)p;
+                carry  = (std::uint64_t)(p >> 64);
+            }
+            u128 s       = (u128)t[N64] + carry;
+            t[N64]       = (std::uint64_t)s;
+            t[N64 + 1]   = (std::uint64_t)(s >> 64);
+
+            std::uint64_t m = t[0] * np;
+            u128          p = (u128)m * q[0] + t[0];
+            carry           = (std::uint64_t)(p >> 64);
+            for (int j = 1; j < N64; j++)
+            {
+                p        = (u128)m * q[j] + t[j] + carry;
+                t[j - 1] = (std::uint64_t)p;
+                carry    = (std::uint64_t)(p >> 64);
+            }
+            s          = (u128)t[N64] + carry;
+            t[N64 - 1] = (std::uint64_t)s;
+            t[N64]     = t[N64 + 1] + (std::uint64_t)(s >> 64);
+        }
+        reduce(r, t, t[N64]);
+    }
+
+    static inline void fromLimbs(Element& r, const MontFieldDetail::Limbs& l)
+    {
+        for (int j = 0; j < N64; j++)
+        {
+            r.v[j] = l.v[j];
+        }
+    }
+
+public:
+    MontField()
+    {
+        set(fZero, 0);
+        fromLimbs(fOne, R1);
+        neg(fNegOne, fOne);
+    }
+
+    const Element& zero() { return fZero; };
+    const Element& one() { return fOne; };
+    const Element& negOne() { return fNegOne; };
+    Element        set(int value)
+    {
+        Element r;
+        set(r, value);
+        return r;
+    }
+    void set(Element& r, int value)
+    {
+        for (int j = 0; j < N64; j++)
+        {
+            r.v[j] = 0;
+        }
+        r.v[0] = value < 0 ? -(std::uint64_t)(std::int64_t)value : value;
+        toMontgomery(r, r);
+        if (value < 0)
+            neg(r, r);
+    }
+
+    void fromString(Element& r, const std::string& n, uint32_t radix = 10)
+    {
+        mpz_t mr;
+        mpz_init_set_str(mr, n.c_str(), radix);
+        mpz_t mq;
+        modulus(mq);
+        mpz_fdiv_r(mr, mr, mq);
+        fromMpz(r, mr);
+        mpz_clear(mq);
+        mpz_clear(mr);
+    }
+    std::string toString(const Element& a, uint32_t radix = 10)
+    {
+        mpz_t r;
+        mpz_init(r);
+        toMpz(r, a);
+        char*       res = mpz_get_str(0, radix, r);
+        std::string resS(res);
+        free(res);
+        mpz_clear(r);
+        return resS;
+    }
+
+    inline void copy(Element& r, const Element& a) { r = a; };
+    inline void swap(Element& a, Element& b)
+    {
+        Element t = a;
+        a         = b;
+        b         = t;
+    };
+    inline void add(Element& r, const Element& a, const Element& b)
+    {
+        std::uint64_t s[N64];
+        std::uint64_t carry = 0;
+        for (int j = 0; j < N64; j++)
+        {
+            u128 t = (u128)a.v[j] + b.v[j] + carry;
+            s[j]   = (std::uint64_t)t;
+            carry  = (std::uint64_t)(t >> 64);
+        }
+        reduce(r.v, s, carry);
+    };
+    inline void sub(Element& r, const Element& a, const Element& b)
+    {
+        std::uint64_t borrow = 0;
+        for (int j = 0; j < N64; j++)
+        {
+            u128 t = (u128)a.v[j] - b.v[j] - borrow;
+            r.v[j] = (std::uint64_t)t;
+            borrow = (std::uint64_t)(t >> 64) & 1;
+        }
+        std::uint64_t mask  = 0 - borrow;
+        std::uint64_t carry = 0;
+        for (int j = 0; j < N64; j++)
+        {
+            u128 t = (u128)r.v[j] + (q[j] & mask) + carry;
+            r.v[j] = (std::uint64_t)t;
+            carry  = (std::uint64_t)(t >> 64);
+        }
+    };
+    inline void mul(Element& r, const Element& a, const Element& b)
+    {
+        mulRaw(r.v, a.v, b.v);
+    };
+
+    inline Element add(const Element& a, const Element& b)
+    {
+        Element r;
+        add(r, a, b);
+        return r;
+    };
+    inline Element sub(const Element& a, const Element& b)
+    {
+        Element r;
+        sub(r, a, b);
+        return r;
+    };
+    inline Element mul(const Element& a, const Element& b)
+    {
+        Element r;
+        mul(r, a, b);
+        return r;
+    };
+
+    inline Element neg(const Element& a)
+    {
+        Element r;
+        neg(r, a);
+        return r;
+    };
+    inline Element square(const Element& a)
+    {
+        Element r;
+        square(r, a);
+        return r;
+    };
+
+    inline Element add(int a, const Element& b) { return add(set(a), b); };
+    inline Element sub(int a, const Element& b) { return sub(set(a), b); };
+    inline Element mul(int a, const Element& b) { return mul(set(a), b); };
+
+    inline Element add(const Element& a, int b) { return add(a, set(b)); };
+    inline Element sub(const Element& a, int b) { return sub(a, set(b)); };
+    inline Element mul(const Element& a, int b) { return mul(a, set(b)); };
+
+    inline void mul1(Element& r, const Element& a, uint64_t b)
+    {
+        std::uint64_t raw[N64] = {b, 0, 0, 0};
+        mulRaw(r.v, a.v, raw);
+    };
+    inline void neg(Element& r, const Element& a) { sub(r, fZero, a); };
+    inline void square(Element& r, const Element& a) { mul(r, a, a); };
+
+    void inv(Element& r, const Element& a)
+    {
+        mpz_t mr;
+        mpz_t mq;
+        mpz_init(mr);
+        modulus(mq);
+        mpz_import(mr, N64, -1, 8, -1, 0, (const void*)(a.v));
+        mpz_invert(mr, mr, mq);
+        for (int j = 0; j < N64; j++)
+        {
+            r.v[j] = 0;
+        }
+        mpz_export((void*)(r.v), NULL, -1, 8, -1, 0, mr);
+        mulRaw(r.v, r.v, R3.v);
+        mpz_clear(mq);
+        mpz_clear(mr);
+    }
+    void div(Element& r, const Element& a, const Element& b)
+    {
+        Element tmp;
+        inv(tmp, b);
+        mul(r, a, tmp);
+    }
+    // Montgomery's trick: inverts n elements with a single inversion and
+    // 3n multiplications. Zeros are skipped and map to zero. r and a must
+    // not overlap.
+    void batchInverse(Element* r, const Element* a, uint64_t n)
+    {
+        if (n == 0)
+            return;
+        Element acc;
+        copy(acc, fOne);
+        for (uint64_t i = 0; i < n; i++)
+        {
+            copy(r[i], acc);
+            if (!isZero(a[i]))
+                mul(acc, acc, a[i]);
+        }
+        inv(acc, acc);
+        for (uint64_t i = n; i-- > 0;)
+        {
+            if (isZero(a[i]))
+            {
+                copy(r[i], fZero);
+                continue;
+            }
+            mul(r[i], r[i], acc);
+            mul(acc, acc, a[i]);
+        }
+    }
+    void exp(Element& r, const Element& base, uint8_t* scalar,
+             unsigned int scalarSize)
+    {
+        Element b = base;
+        copy(r, fOne);
+        for (int i = scalarSize * 8 - 1; i >= 0; i--)
+        {
+            square(r, r);
+            if (scalar[i >> 3] & (1 << (i & 7)))
+                mul(r, r, b);
+        }
+    }
+
+    inline void toMontgomery(Element& r, const Element& a)
+    {
+        mulRaw(r.v, a.v, R2.v);
+    };
+    inline void fromMontgomery(Element& r, const Element& a)
+    {
+        std::uint64_t one[N64] = {1, 0, 0, 0};
+        mulRaw(r.v, a.v, one);
+    };
+    inline int eq(const Element& a, const Element& b)
+    {
+        std::uint64_t d = 0;
+        for (int j = 0; j < N64; j++)
+        {
+            d |= a.v[j] ^ b.v[j];
+        }
+        return d == 0;
+    };
+    inline int isZero(const Element& a) { return eq(a, fZero); };
+
+    void toMpz(mpz_t r, const Element& a)
+    {
+        Element tmp;
+        fromMontgomery(tmp, a);
+        mpz_import(r, N64, -1, 8, -1, 0, (const void*)tmp.v);
+    }
+    void fromMpz(Element& r, const mpz_t a)
+    {
+        for (int j = 0; j < N64; j++)
+        {
+            r.v[j] = 0;
+        }
+        mpz_export((void*)(r.v), NULL, -1, 8, -1, 0, a);
+        toMontgomery(r, r);
+    }
+
+    int toRprBE(const Element& element, uint8_t* data, int bytes)
+    {
+        if (bytes < N64 * 8)
+            return -(N64 * 8);
+        mpz_t r;
+        mpz_init(r);
+        toMpz(r, element);
+        mpz_export(data, NULL, 1, 8, 1, 0, r);
+        mpz_clear(r);
+        return N64 * 8;
+    }
+    int fromRprBE(Element& element, const uint8_t* data, int bytes)
+    {
+        if (bytes < N64 * 8)
+            return -(N64 * 8);
+        mpz_t r;
+        mpz_init(r);
+        mpz_import(r, N64 * 8, 0, 1, 0, 0, data);
+        fromMpz(element, r);
+        mpz_clear(r);
+        return N64 * 8;
+    }
+
+    int bytes(void) { return N64 * 8; };
+
+    void fromUI(Element& r, unsigned long int v)
+    {
+        for (int j = 0; j < N64; j++)
+        {
+            r.v[j] = 0;
+        }
+        r.v[0] = v;
+        toMontgomery(r, r);
+    }
+
+    static MontField field;
+
+private:
+    static void modulus(mpz_t r)
+    {
+        mpz_init(r);
+        mpz_import(r, N64, -1, 8, -1, 0, (const void*)q);
+    }
+};
+
+template <typename Params>
+MontField<Params> MontField<Params>::field;
+
+#endif // MONT_FIELD_HPP
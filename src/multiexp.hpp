@@ -4,15 +4,314 @@
 #define PME2_PACK_FACTOR 2
 #define PME2_MAX_CHUNK_SIZE_BITS 16
 #define PME2_MIN_CHUNK_SIZE_BITS 2
+// Planned digits are stored in 16 bits, which holds the signed digits of
+// windows up to 15 bits.
+#define PME2_PLAN_MAX_CHUNK_SIZE_BITS 15
 
+// Decompose the scalars into signed (Booth) digits in
+// [-2^(bitsPerChunk-1), 2^(bitsPerChunk-1)] so that every window needs only
+// half of the buckets; negative digits subtract the base instead.
+#ifndef PME2_SIGNED_DIGITS
+#    define PME2_SIGNED_DIGITS 1
+#endif
+
+// Windows of at least this many bits keep the per thread buckets in affine
+// form and accumulate them with batched affine additions (one shared field
+// inversion per batch), which is ~6 multiplications per addition instead of
+// the ~8 of a mixed XYZZ addition. Small windows collide too often to batch.
+#ifndef PME2_BATCH_AFFINE_MIN_CHUNK_SIZE_BITS
+#    define PME2_BATCH_AFFINE_MIN_CHUNK_SIZE_BITS 10
+#endif
+#define PME2_MIN_AFFINE_BATCH_SIZE 16
+#define PME2_MAX_AFFINE_BATCH_SIZE 1024
+
+// Curves with an endomorphism split every scalar in two halves of 128 bits
+// (GLV), doubling the bases virtually and halving the number of windows.
+#ifndef PME2_GLV
+#    define PME2_GLV 1
+#endif
+#define PME2_GLV_SCALAR_SIZE 16
+
+// Runs the windows (split in segments of points when there are fewer windows
+// than threads) as independent tasks, each with its own buckets, instead of
+// one window at a time with a barrier after every pass.
+#ifndef PME2_WINDOW_PARALLEL
+#    define PME2_WINDOW_PARALLEL 1
+#endif
+
+// Number of segments the buckets of a window are split in for the parallel
+// reduction of the sorted (memory bounded) mode.
+#define PME2_SORTED_REDUCE_SEGMENTS 64
+
+// Sorts the scalars out before the windows: zeros are dropped, the bases of
+// the ones are just added up and scalars below 2^PME2_SMALL_SCALAR_BITS go
+// to a single window of buckets. Only the rest runs through all the windows.
+// Witnesses are mostly bits and booleans, so this is often most of them.
+#ifndef PME2_SPARSE_SCALARS
+#    define PME2_SPARSE_SCALARS 1
+#endif
+#define PME2_SMALL_SCALAR_BITS 8
+// Scalars looked at before sorting them out: when all are dense the vector
+// is taken as dense and runs through the windows as it is.
+#define PME2_SPARSE_SAMPLE_SIZE 256
+// Scalars per block of the parallel count and fill.
+#define PME2_CLASSIFY_BLOCK_SIZE 16384
+
+// Bases per block of the batched multiexps: a block is read from memory once
+// and added to the buckets of every multiexp of the batch, so it should stay
+// in L2 meanwhile.
+#ifndef PME2_BATCH_BLOCK_SIZE
+#    define PME2_BATCH_BLOCK_SIZE 1024
+#endif
+
+#include "batch_inverse.hpp"
+#include "glv.hpp"
 #include "misc.hpp"
 #include "multiexp.hpp"
 #include "scope_guard.hpp"
+#include "workspace.hpp"
 
 #include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cassert>
 #include <cstdint>
 #include <memory.h>
+#include <memory>
+#include <vector>
+
+// Accumulates points into a set of affine buckets. Additions are queued and
+// executed in batches that share a single inversion, so a batch can not
+// contain two additions into the same bucket. Such collisions are deferred:
+// a point whose bucket is busy waits in a queue, where it is first paired
+// with other points for the same bucket, so that even the degenerate case of
+// all the points going to one bucket still fills whole batches.
+template <typename Curve>
+class AffineBucketBatch
+{
+    typedef typename Curve::PointAffine    PointAffine;
+    typedef typename Curve::Field::Element Element;
+
+    struct BucketState
+    {
+        uint32_t busy;      // batch that already adds into the bucket
+        uint32_t pairBatch; // batch in which pairSlot is waiting for a pair
+        uint32_t pairSlot;
+    };
+
+    struct Pending
+    {
+        uint64_t    bucket;
+        PointAffine p;
+    };
+
+    Curve&                   g;
+    PointAffine*             buckets;
+    uint64_t                 batchSize;
+    uint64_t                 nOps;
+    uint32_t                 batchId;
+    std::vector<BucketState> state;
+    std::vector<int64_t>     dst; // bucket index, or -1 - slot in the queue
+    std::vector<PointAffine> src;
+    std::vector<Element>     denoms;
+    std::vector<Element>     invs;
+    std::vector<Pending>     queue;
+    std::vector<Pending>     retry;
+
+    PointAffine& target(int64_t d)
+    {
+        return d >= 0 ? buckets[d] : queue[-1 - d].p;
+    }
+
+    void schedule(int64_t d, PointAffine& p)
+    {
+        dst[nOps] = d;
+        g.copy(src[nOps], p);
+        nOps++;
+    }
+
+    void addPoint(uint64_t bucket, PointAffine& p);
+    void flush();
+    void drain();
+
+public:
+    AffineBucketBatch(Curve& _g)
+        : g(_g)
+        , buckets(nullptr)
+        , batchSize(0)
+        , nOps(0)
+        , batchId(1)
+    {
+    }
+
+    void init(PointAffine* _buckets, uint64_t nBuckets, uint64_t _batchSize);
+    void add(uint64_t bucket, PointAffine& p, bool negate);
+    void finish();
+};
+
+template <typename Curve>
+void AffineBucketBatch<Curve>::init(PointAffine* _buckets, uint64_t nBuckets,
+                                    uint64_t _batchSize)
+{
+    buckets   = _buckets;
+    batchSize = _batchSize;
+    nOps      = 0;
+    batchId   = 1;
+    state.assign(nBuckets, BucketState{0, 0, 0});
+    dst.resize(batchSize);
+    src.resize(batchSize);
+    denoms.resize(batchSize);
+    invs.resize(batchSize);
+    queue.clear();
+    retry.clear();
+}
+
+template <typename Curve>
+void AffineBucketBatch<Curve>::addPoint(uint64_t bucket, PointAffine& p)
+{
+    if (g.isZero(p))
+        return;
+
+    BucketState& st = state[bucket];
+    if (st.busy != batchId)
+    {
+        if (g.isZero(buckets[bucket]))
+        {
+            g.copy(buckets[bucket], p);
+            return;
+        }
+        st.busy = batchId;
+        schedule(bucket, p);
+    }
+    else if (st.pairBatch == batchId)
+    {
+        st.pairBatch = 0;
+        schedule(-1 - int64_t(st.pairSlot), p);
+    }
+    else
+    {
+        st.pairBatch = batchId;
+        st.pairSlot  = queue.size();
+        queue.push_back(Pending{bucket, p});
+    }
+}
+
+template <typename Curve>
+void AffineBucketBatch<Curve>::flush()
+{
+    for (uint64_t i = 0; i < nOps; i++)
+    {
+        g.addAffineDenominator(denoms[i], target(dst[i]), src[i]);
+    }
+
+    g.F.batchInverse(invs.data(), denoms.data(), nOps);
+
+    for (uint64_t i = 0; i < nOps; i++)
+    {
+        PointAffine& t = target(dst[i]);
+        g.addAffineWithInverse(t, t, src[i], invs[i]);
+    }
+
+    nOps = 0;
+    batchId++;
+}
+
+// Runs the pending batch and gives the deferred points another chance.
+template <typename Curve>
+void AffineBucketBatch<Curve>::drain()
+{
+    flush();
+
+    retry.swap(queue);
+    queue.clear();
+    for (auto& e : retry)
+    {
+        addPoint(e.bucket, e.p);
+        if (nOps == batchSize)
+            flush();
+    }
+    retry.clear();
+}
+
+template <typename Curve>
+void AffineBucketBatch<Curve>::add(uint64_t bucket, PointAffine& p,
+                                   bool negate)
+{
+    if (negate)
+    {
+        PointAffine tmp;
+        g.neg(tmp, p);
+        addPoint(bucket, tmp);
+    }
+    else
+    {
+        addPoint(bucket, p);
+    }
+
+    if (nOps == batchSize)
+        drain();
+}
+
+template <typename Curve>
+void AffineBucketBatch<Curve>::finish()
+{
+    while (nOps > 0 || !queue.empty())
+        drain();
+}
+
+// Shifted copies of a set of bases that do not change between multiexps:
+// copy j holds 2^(j * chunksPerCopy * bitsPerChunk) * P. A multiexp over the
+// table feeds window j * chunksPerCopy + t of every scalar to copy j, so it
+// only runs chunksPerCopy windows over nCopies times more points, saving the
+// doublings and bucket reductions of the other windows. Copy 0 points to
+// the original bases, the other copies live in storage.
+template <typename Curve>
+struct FixedBaseTable
+{
+    uint64_t                                  n;
+    uint64_t                                  scalarSize;
+    bool                                      glv;
+    uint64_t                                  bitsPerChunk;
+    uint64_t                                  chunksPerCopy;
+    std::vector<typename Curve::PointAffine*> copies;
+    std::vector<typename Curve::PointAffine>  storage;
+
+    uint64_t nCopies() { return copies.size(); }
+};
+
+// Window digits of a set of scalars, computed once and shared by the
+// multiexps that use the same scalars or a range of them. Digits are stored
+// window major, window w of scalar i at w * nScalars() + i. With GLV the
+// scalars are the k1 halves followed by the k2 halves, signs folded in.
+// That is 2 bytes per window and scalar, about 75 MB for 2^21 scalars with
+// GLV.
+struct ScalarPlan
+{
+    uint8_t*             scalars;
+    uint64_t             scalarSize;
+    uint64_t             n;
+    bool                 glv;
+    uint64_t             bitsPerChunk;
+    uint64_t             nChunks;
+    std::vector<int16_t> digits;
+
+    uint64_t nScalars() { return glv ? 2 * n : n; }
+};
+
+// Scratch buffers of the multiexps, kept by callers that run them
+// repeatedly. A workspace serves one multiexp at a time. memoryBudget is the
+// upper bound in bytes for the buckets of the multiexps run with it, 0 for
+// none.
+struct MultiexpWorkspace
+{
+    WorkspaceBuffer buckets; // the buckets of every thread
+    WorkspaceBuffer accs;    // packed buckets of the batch affine mode
+    WorkspaceBuffer chunkResults;
+    WorkspaceBuffer sall;
+    uint64_t        memoryBudget = 0;
+};
 
 template <typename Curve>
 class ParallelMultiexp
@@ -25,27 +324,108 @@ class ParallelMultiexp
     };
 
     typename Curve::PointAffine* bases;
+    uint64_t                     nBases;
+    typename Curve::PointAffine** copies;
+    uint64_t                     nCopies;
     uint8_t*                     scalars;
     uint64_t                     scalarSize;
     uint64_t                     n;
+    bool                         glv;
+    std::vector<uint8_t>         glvScalars;
+    std::vector<uint8_t>         glvNeg;
+    ScalarPlan*                  plan;
+    uint64_t                     planOffset;
+    bool                         sparse;
+    std::vector<uint32_t>        dense;
+    std::vector<uint32_t>        ones;
+    std::vector<uint32_t>        small;
+    std::vector<uint32_t>        smallValues;
     uint64_t                     nThreads;
     uint64_t                     bitsPerChunk;
     uint64_t                     accsPerChunk;
     uint64_t                     nChunks;
+    uint64_t                     memoryBudget;
     Curve&                       g;
     PaddedPoint*                 accs;
+    typename Curve::PointAffine* affineAccs;
+    std::vector<AffineBucketBatch<Curve>> affineBatches;
+    MultiexpWorkspace            ownWorkspace;
+    MultiexpWorkspace*           ws;
 
+    void reset();
     void initAccs();
+    bool glvAllowed(uint64_t _scalarSize);
+    enum ScalarClass
+    {
+        scalar_is_zero,
+        scalar_is_one,
+        scalar_is_small,
+        scalar_is_dense
+    };
+    ScalarClass scalarClass(uint64_t i, uint64_t& low);
+    void classifyScalars();
+    uint64_t nPoints();
+    uint64_t scalarIndex(uint64_t i);
+    void     pointAt(uint64_t i, uint64_t& copy, uint64_t& idx);
+    void     sumSmall(typename Curve::Point& res, std::vector<uint32_t>& idx,
+                      uint32_t* values, uint64_t nBuckets);
+    void     sumSparse(typename Curve::Point& res);
+    bool splitScalars();
+    typename Curve::PointAffine& getBase(uint64_t copy, uint64_t idx,
+                                         typename Curve::PointAffine& tmp);
+    uint64_t chooseBitsPerChunk(uint64_t nPoints);
+    uint64_t bucketSize();
+    uint64_t windowsMemory();
+    uint64_t sortedMemory();
+    void     fitMemoryBudget();
+    bool useBatchAffine();
+    void initAffineAccs();
 
-    uint64_t getChunk(uint64_t scalarIdx, uint64_t chunkIdx);
+    uint64_t getBits(uint64_t scalarIdx, uint64_t bitStart, uint64_t nBits);
+    int64_t  getChunk(uint64_t scalarIdx, uint64_t chunkIdx);
+    uint64_t getNumChunks();
+    void     addToAcc(int idThread, int64_t chunkValue,
+                      typename Curve::PointAffine& base);
     void     processChunk(uint64_t idxChunk);
     void     processChunk(uint64_t idxChunk, uint64_t nx, uint64_t x[]);
+    void     processChunkBatchAffine(uint64_t idxChunk);
     void     packThreads();
+    void     packThreadsBatchAffine();
     void     reduce(typename Curve::Point& res, uint64_t nBits);
+    void     reduceChunk(typename Curve::Point& res);
+    void     processWindow(typename Curve::Point& res, uint64_t idChunk,
+                           uint64_t begin, uint64_t end);
+    void     multiexpWindows(typename Curve::Point* chunkResults);
+    template <typename Bucket>
+    void reduceBuckets(typename Curve::Point& res, Bucket* buckets);
+    void multiexpSorted(typename Curve::Point* chunkResults);
+    void     multiexpChunks(typename Curve::Point& r);
+    bool usePlan(typename Curve::PointAffine* _bases, ScalarPlan& _plan,
+                 uint64_t offset, uint64_t _n);
+    bool usePlan(FixedBaseTable<Curve>& table, ScalarPlan& _plan,
+                 uint64_t offset);
+    template <typename Fallback>
+    void multiexpBatch(typename Curve::Point*                          r,
+                       std::vector<std::unique_ptr<ParallelMultiexp>>& pms,
+                       std::vector<uint8_t>& planned, Fallback fallback);
+    template <typename Add>
+    void scanBatch(std::vector<ParallelMultiexp*>& batch, uint64_t idChunk,
+                   uint64_t begin, uint64_t end, Add add);
+    void processWindowBatch(std::vector<ParallelMultiexp*>& batch,
+                            typename Curve::Point* res, uint64_t idChunk,
+                            uint64_t begin, uint64_t end);
 
 public:
-    ParallelMultiexp(Curve& _g)
-        : g(_g)
+    ParallelMultiexp(Curve& _g, MultiexpWorkspace* _ws = nullptr)
+        : copies(&bases)
+        , nCopies(1)
+        , glv(false)
+        , plan(nullptr)
+        , planOffset(0)
+        , sparse(false)
+        , memoryBudget(_ws ? _ws->memoryBudget : 0)
+        , g(_g)
+        , ws(_ws ? _ws : &ownWorkspace)
     {
     }
     void multiexp(typename Curve::Point& r, typename Curve::PointAffine* _bases,
@@ -54,8 +434,43 @@ public:
     void multiexp(typename Curve::Point& r, typename Curve::PointAffine* _bases,
                   uint8_t* _scalars, uint64_t _scalarSize, uint64_t _n,
                   uint64_t nx, uint64_t x[], uint64_t _nThreads = 0);
+
+    void precompute(FixedBaseTable<Curve>&       table,
+                    typename Curve::PointAffine* _bases, uint64_t _n,
+                    uint64_t _scalarSize, uint64_t maxCopies);
+    void multiexp(typename Curve::Point& r, FixedBaseTable<Curve>& table,
+                  uint8_t* _scalars);
+
+    void makePlan(ScalarPlan& _plan, uint8_t* _scalars, uint64_t _scalarSize,
+                  uint64_t _n, uint64_t _bitsPerChunk = 0,
+                  uint64_t minChunks = 0);
+    void multiexp(typename Curve::Point& r, typename Curve::PointAffine* _bases,
+                  ScalarPlan& _plan, uint64_t offset, uint64_t _n);
+    void multiexp(typename Curve::Point& r, FixedBaseTable<Curve>& table,
+                  ScalarPlan& _plan, uint64_t offset);
+
+    // Multiexps of the same bases with several plans at once, r[v] gets the
+    // one of _plans[v].
+    void multiexp(typename Curve::Point* r, typename Curve::PointAffine* _bases,
+                  ScalarPlan** _plans, uint64_t nPlans, uint64_t offset,
+                  uint64_t _n);
+    void multiexp(typename Curve::Point* r, FixedBaseTable<Curve>& table,
+                  ScalarPlan** _plans, uint64_t nPlans, uint64_t offset);
 };
 
+// Back to a single copy of the bases and no plan, every entry point starts
+// here so that nothing is left over from the previous multiexp.
+template <typename Curve>
+void ParallelMultiexp<Curve>::reset()
+{
+    copies     = &bases;
+    nCopies    = 1;
+    glv        = false;
+    plan       = nullptr;
+    planOffset = 0;
+    sparse     = false;
+}
+
 template <typename Curve>
 void ParallelMultiexp<Curve>::initAccs()
 {
@@ -73,212 +488,1126 @@ void ParallelMultiexp<Curve>::initAccs()
 }
 
 template <typename Curve>
-uint64_t ParallelMultiexp<Curve>::getChunk(uint64_t scalarIdx,
-                                           uint64_t chunkIdx)
+bool ParallelMultiexp<Curve>::glvAllowed(uint64_t _scalarSize)
 {
-    uint64_t bitStart             = chunkIdx * bitsPerChunk;
-    uint64_t byteStart            = bitStart / 8;
-    uint64_t efectiveBitsPerChunk = bitsPerChunk;
-    if (byteStart > scalarSize - 8)
-        byteStart = scalarSize - 8;
-    if (bitStart + bitsPerChunk > scalarSize * 8)
-        efectiveBitsPerChunk = scalarSize * 8 - bitStart;
-    uint64_t shift = bitStart - byteStart * 8;
-    uint64_t v     = *(uint64_t*)(scalars + scalarIdx * scalarSize + byteStart);
-    v              = v >> shift;
-    v              = v & ((1 << efectiveBitsPerChunk) - 1);
-    return uint64_t(v);
+#if PME2_GLV
+    return g.hasEndomorphism() && _scalarSize > PME2_GLV_SCALAR_SIZE &&
+           _scalarSize <= 32;
+#else
+    return false;
+#endif
 }
 
-// go over all the numbers (windowed numbered) in the window/chunk and add them
-// to their corresponding index
+// Class of the scalar i, with its low 64 bits.
 template <typename Curve>
-void ParallelMultiexp<Curve>::processChunk(uint64_t idChunk)
+typename ParallelMultiexp<Curve>::ScalarClass
+ParallelMultiexp<Curve>::scalarClass(uint64_t i, uint64_t& low)
 {
-    // #pragma omp parallel for
-    //     for (uint64_t i = 0; i < n; i++)
+    uint8_t* s = scalars + i * scalarSize;
+    low        = 0;
+    memcpy(&low, s, std::min<uint64_t>(scalarSize, sizeof(low)));
+    for (uint64_t j = sizeof(low); j < scalarSize; j++)
+    {
+        if (s[j] != 0)
+            return scalar_is_dense;
+    }
+    if (low >> PME2_SMALL_SCALAR_BITS)
+        return scalar_is_dense;
+    if (low == 0)
+        return scalar_is_zero;
+    return low == 1 ? scalar_is_one : scalar_is_small;
+}
+
+// Fills dense with the indexes of the scalars that need the windows, and
+// ones and small with the others but zero. Leaves sparse unset, so that
+// the windows run over all the scalars, when there is nothing to sort out.
+// The scalars are counted by blocks in parallel, then every block fills its
+// own part of the lists.
+template <typename Curve>
+void ParallelMultiexp<Curve>::classifyScalars()
+{
+    sparse = false;
+    dense.clear();
+    ones.clear();
+    small.clear();
+    smallValues.clear();
+
+#if PME2_SPARSE_SCALARS
+    uint64_t step   = std::max<uint64_t>(1, nBases / PME2_SPARSE_SAMPLE_SIZE);
+    bool     sorted = false;
+    for (uint64_t i = 0; i < nBases && !sorted; i += step)
+    {
+        uint64_t low;
+        sorted = scalarClass(i, low) != scalar_is_dense;
+    }
+    if (!sorted)
+        return;
+
+    uint64_t nBlocks =
+        (nBases + PME2_CLASSIFY_BLOCK_SIZE - 1) / PME2_CLASSIFY_BLOCK_SIZE;
+    std::vector<uint64_t> counts(nBlocks * 4);
     tbb::parallel_for(
-        tbb::blocked_range<std::uint32_t>(0, n),
-        [&](tbb::blocked_range<std::uint32_t> range)
+        tbb::blocked_range<std::uint64_t>(0, nBlocks, 1),
+        [&](auto range)
         {
-            for (auto i = range.begin(); i < range.end(); ++i)
-
+            for (auto b = range.begin(); b < range.end(); ++b)
             {
-                if (g.isZero(bases[i]))
-                    continue;
-                uint64_t chunkValue = getChunk(i, idChunk);
+                uint64_t end = std::min<uint64_t>(
+                    nBases, (b + 1) * PME2_CLASSIFY_BLOCK_SIZE);
+                uint64_t low;
+                for (uint64_t i = b * PME2_CLASSIFY_BLOCK_SIZE; i < end; i++)
+                    counts[b * 4 + scalarClass(i, low)]++;
+            }
+        });
 
-                int idThread = tbb::this_task_arena::current_thread_index();
+    // Turn the counts into the offsets of every block in each list.
+    uint64_t total[4] = {0, 0, 0, 0};
+    for (uint64_t b = 0; b < nBlocks; b++)
+    {
+        for (int k = 0; k < 4; k++)
+        {
+            uint64_t c        = counts[b * 4 + k];
+            counts[b * 4 + k] = total[k];
+            total[k] += c;
+        }
+    }
+    if (total[scalar_is_dense] == nBases)
+        return;
 
-                if (chunkValue)
+    sparse = true;
+    dense.resize(total[scalar_is_dense]);
+    ones.resize(total[scalar_is_one]);
+    small.resize(total[scalar_is_small]);
+    smallValues.resize(total[scalar_is_small]);
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, nBlocks, 1),
+        [&](auto range)
+        {
+            for (auto b = range.begin(); b < range.end(); ++b)
+            {
+                uint64_t  end = std::min<uint64_t>(
+                    nBases, (b + 1) * PME2_CLASSIFY_BLOCK_SIZE);
+                uint64_t* pos = &counts[b * 4];
+                uint64_t  low;
+                for (uint64_t i = b * PME2_CLASSIFY_BLOCK_SIZE; i < end; i++)
                 {
-                    g.add(accs[idThread * accsPerChunk + chunkValue].p,
-                          accs[idThread * accsPerChunk + chunkValue].p,
-                          bases[i]);
+                    switch (scalarClass(i, low))
+                    {
+                    case scalar_is_dense:
+                        dense[pos[scalar_is_dense]++] = i;
+                        break;
+                    case scalar_is_one:
+                        ones[pos[scalar_is_one]++] = i;
+                        break;
+                    case scalar_is_small:
+                        smallValues[pos[scalar_is_small]] = low;
+                        small[pos[scalar_is_small]++]     = i;
+                        break;
+                    default:
+                        break;
+                    }
                 }
             }
         });
+#endif
 }
 
+// Number of points the windows run over in each copy of the bases.
 template <typename Curve>
-void ParallelMultiexp<Curve>::processChunk(uint64_t idChunk, uint64_t nX,
-                                           uint64_t size[])
+uint64_t ParallelMultiexp<Curve>::nPoints()
 {
-    // #pragma omp parallel for
-    //             for (uint64_t i = 0; i < n; i++)
+    if (!sparse)
+        return n;
+    return glv ? 2 * dense.size() : dense.size();
+}
+
+// Scalar of the point i in [0, nPoints()).
+template <typename Curve>
+uint64_t ParallelMultiexp<Curve>::scalarIndex(uint64_t i)
+{
+    if (!sparse)
+        return i;
+    return i < dense.size() ? dense[i] : nBases + dense[i - dense.size()];
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::pointAt(uint64_t i, uint64_t& copy,
+                                      uint64_t& idx)
+{
+    uint64_t np = nPoints();
+    copy        = i / np;
+    idx         = scalarIndex(i - copy * np);
+}
+
+// Adds up values[j] * bases[idx[j]] (1 * bases[idx[j]] when values is null)
+// with a single window of nBuckets affine buckets per segment.
+template <typename Curve>
+void ParallelMultiexp<Curve>::sumSmall(typename Curve::Point& res,
+                                       std::vector<uint32_t>& idx,
+                                       uint32_t* values, uint64_t nBuckets)
+{
+    uint64_t nSegments = std::min<uint64_t>(
+        nThreads, std::max<uint64_t>(1, idx.size() / (nBuckets * 16)));
+    uint64_t segmentSize = (idx.size() + nSegments - 1) / nSegments;
+
+    std::vector<typename Curve::Point> results(nSegments);
+
     tbb::parallel_for(
-        tbb::blocked_range<std::uint64_t>(0, n),
+        tbb::blocked_range<std::uint64_t>(0, nSegments, 1),
         [&](auto range)
         {
-            for (auto i = range.begin(); i < range.end(); i++)
+            for (auto s = range.begin(); s < range.end(); ++s)
             {
-                uint mod = i % nX;
-                uint len = size[mod] - 1;
-                if (i < 0 || i > len * nX + mod)
-                    continue;
-                if (g.isZero(bases[i]))
-                    continue;
+                uint64_t begin = s * segmentSize;
+                uint64_t end   = std::min<uint64_t>(idx.size(), begin + segmentSize);
 
-                int idThread = tbb::this_task_arena::current_thread_index();
+                std::vector<typename Curve::PointAffine> buckets(nBuckets);
+                for (auto& b : buckets)
+                    g.copy(b, g.zeroAffine());
 
-                uint64_t chunkValue = getChunk(i, idChunk);
+                AffineBucketBatch<Curve> batch(g);
+                batch.init(buckets.data(), nBuckets,
+                           std::clamp<uint64_t>((end - begin) >> 4,
+                                                PME2_MIN_AFFINE_BATCH_SIZE,
+                                                PME2_MAX_AFFINE_BATCH_SIZE));
+                for (uint64_t j = begin; j < end; j++)
+                    batch.add(values ? values[j] : 1, bases[idx[j]], false);
+                batch.finish();
 
-                if (chunkValue)
+                typename Curve::Point sum;
+                g.copy(sum, g.zero());
+                g.copy(results[s], g.zero());
+                for (uint64_t k = nBuckets - 1; k > 0; k--)
                 {
-                    g.add(accs[idThread * accsPerChunk + chunkValue].p,
-                          accs[idThread * accsPerChunk + chunkValue].p,
-                          bases[i]);
+                    if (!g.isZero(buckets[k]))
+                        g.add(sum, sum, buckets[k]);
+                    g.add(results[s], results[s], sum);
                 }
             }
         });
+
+    for (uint64_t s = 0; s < nSegments; s++)
+        g.add(res, res, results[s]);
 }
 
-// This function takes all chunks and accumulate them to the first chunk's
-// indexes
+// Part of the multiexp of the scalars sorted out by classifyScalars().
 template <typename Curve>
-void ParallelMultiexp<Curve>::packThreads()
+void ParallelMultiexp<Curve>::sumSparse(typename Curve::Point& res)
 {
-    // #pragma omp parallel for
-    //     for (uint64_t i = 0; i < accsPerChunk; i++)
-    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, accsPerChunk),
-                      [&](auto range)
-                      {
-                          for (auto i = range.begin(); i < range.end(); ++i)
-                          {
-                              for (uint64_t j = 1; j < nThreads; j++)
-                              {
-                                  if (!g.isZero(accs[j * accsPerChunk + i].p))
-                                  {
-                                      g.add(accs[i].p, accs[i].p,
-                                            accs[j * accsPerChunk + i].p);
-                                      g.copy(accs[j * accsPerChunk + i].p,
-                                             g.zero());
-                                  }
-                              }
-                          }
-                      });
+    g.copy(res, g.zero());
+    if (!ones.empty())
+        sumSmall(res, ones, nullptr, 2);
+    if (!small.empty())
+        sumSmall(res, small, smallValues.data(),
+                 uint64_t(1) << PME2_SMALL_SCALAR_BITS);
 }
 
+// Replaces the scalars by their GLV halves: scalar i is k1 of base i and
+// scalar nBases + i is k2, to be multiplied by the endomorphism of base i.
+// Only the dense scalars are split when the others were sorted out.
 template <typename Curve>
-void ParallelMultiexp<Curve>::reduce(typename Curve::Point& res, uint64_t nBits)
+bool ParallelMultiexp<Curve>::splitScalars()
 {
-    if (nBits == 1)
-    {
-        g.copy(res, accs[1].p);
-        g.copy(accs[1].p, g.zero());
-        return;
-    }
-    uint64_t ndiv2 = 1 << (nBits - 1);
+    glvScalars.resize(2 * nBases * PME2_GLV_SCALAR_SIZE);
+    glvNeg.resize(2 * nBases);
 
-    PaddedPoint* sall = new PaddedPoint[nThreads];
-    MAKE_SCOPE_EXIT(delete_a) { delete[] sall; };
-
-    memset(sall, 0, sizeof(PaddedPoint) * nThreads);
-
-    // #pragma omp parallel for
-    //     for (uint64_t i = 1; i < ndiv2; i++)
+    std::atomic<bool> ok(true);
     tbb::parallel_for(
-        tbb::blocked_range<std::uint64_t>(0, ndiv2),
+        tbb::blocked_range<std::uint64_t>(0, sparse ? dense.size() : nBases),
         [&](auto range)
         {
-            for (auto i = range.begin(); i < range.end(); ++i)
+            for (auto j = range.begin(); j < range.end(); ++j)
             {
-                int idThread = tbb::this_task_arena::current_thread_index();
-                if (!g.isZero(accs[ndiv2 + i].p))
+                uint64_t i = sparse ? dense[j] : j;
+                uint64_t k1[2];
+                uint64_t k2[2];
+                bool     neg1;
+                bool     neg2;
+                if (!aptos::glvSplit(g.glv(), scalars + i * scalarSize,
+                                     scalarSize, k1, neg1, k2, neg2))
                 {
-                    g.add(accs[i].p, accs[i].p, accs[ndiv2 + i].p);
-                    g.add(sall[idThread].p, sall[idThread].p,
-                          accs[ndiv2 + i].p);
-                    g.copy(accs[ndiv2 + i].p, g.zero());
+                    ok = false;
                 }
+                memcpy(&glvScalars[i * PME2_GLV_SCALAR_SIZE], k1,
+                       PME2_GLV_SCALAR_SIZE);
+                memcpy(&glvScalars[(nBases + i) * PME2_GLV_SCALAR_SIZE], k2,
+                       PME2_GLV_SCALAR_SIZE);
+                glvNeg[i]          = neg1;
+                glvNeg[nBases + i] = neg2;
             }
         });
 
-    for (u_int32_t i = 0; i < nThreads; i++)
+    if (!ok)
     {
-        g.add(accs[ndiv2].p, accs[ndiv2].p, sall[i].p);
+        glvScalars.clear();
+        glvNeg.clear();
+        return false;
     }
 
-    typename Curve::Point p1;
-    reduce(p1, nBits - 1);
+    scalars    = glvScalars.data();
+    scalarSize = PME2_GLV_SCALAR_SIZE;
+    n          = 2 * nBases;
+    glv        = true;
+    return true;
+}
 
-    for (u_int32_t i = 0; i < nBits - 1; i++)
-        g.dbl(accs[ndiv2].p, accs[ndiv2].p);
-    g.add(res, p1, accs[ndiv2].p);
-    g.copy(accs[ndiv2].p, g.zero());
-    // delete[] sall;
+// Base of the scalar idx in the given copy, the bases past nBases are
+// computed on the fly.
+template <typename Curve>
+typename Curve::PointAffine&
+ParallelMultiexp<Curve>::getBase(uint64_t copy, uint64_t idx,
+                                 typename Curve::PointAffine& tmp)
+{
+    if (idx < nBases)
+        return copies[copy][idx];
+    g.endomorphism(tmp, copies[copy][idx - nBases]);
+    return tmp;
 }
 
 template <typename Curve>
-void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
-                                       typename Curve::PointAffine* _bases,
-                                       uint8_t* _scalars, uint64_t _scalarSize,
-                                       uint64_t _n, uint64_t _nThreads)
+uint64_t ParallelMultiexp<Curve>::chooseBitsPerChunk(uint64_t nPoints)
 {
-    nThreads = tbb::this_task_arena::max_concurrency();
+    uint64_t bits = aptos::log2((uint32_t)(nPoints / PME2_PACK_FACTOR));
 
-    bases      = _bases;
-    scalars    = _scalars;
-    scalarSize = _scalarSize;
-    n          = _n;
+    if (bits > PME2_MAX_CHUNK_SIZE_BITS)
+        bits = PME2_MAX_CHUNK_SIZE_BITS;
+    if (bits < PME2_MIN_CHUNK_SIZE_BITS)
+        bits = PME2_MIN_CHUNK_SIZE_BITS;
+    return bits;
+}
 
-    if (n == 0)
-    {
-        g.copy(r, g.zero());
+template <typename Curve>
+uint64_t ParallelMultiexp<Curve>::bucketSize()
+{
+    return useBatchAffine() ? sizeof(typename Curve::PointAffine)
+                            : sizeof(typename Curve::Point);
+}
+
+// Bucket memory of the default modes, a set per thread.
+template <typename Curve>
+uint64_t ParallelMultiexp<Curve>::windowsMemory()
+{
+    return nThreads * accsPerChunk * bucketSize();
+}
+
+// Bucket memory of multiexpSorted(), one set shared by all the threads plus
+// the sorted point indexes.
+template <typename Curve>
+uint64_t ParallelMultiexp<Curve>::sortedMemory()
+{
+    return accsPerChunk * (bucketSize() + 2 * sizeof(uint32_t)) +
+           nCopies * nPoints() * sizeof(uint32_t);
+}
+
+// Shrinks the windows to the largest ones for which the default modes or
+// the sorted mode fit in the memory budget, multiexpChunks() then picks the
+// mode. The sorted point indexes do not shrink with the windows: when they
+// alone exceed the budget, only the buckets are held to it.
+template <typename Curve>
+void ParallelMultiexp<Curve>::fitMemoryBudget()
+{
+    if (memoryBudget == 0)
         return;
-    }
-    if (n == 1)
+
+    uint64_t indexes      = nCopies * nPoints() * sizeof(uint32_t);
+    uint64_t sortedBudget = indexes < memoryBudget ? memoryBudget
+                                                   : memoryBudget + indexes;
+
+    for (; bitsPerChunk > PME2_MIN_CHUNK_SIZE_BITS; bitsPerChunk--)
     {
-        g.mulByScalar(r, bases[0], scalars, scalarSize);
-        return;
+#if PME2_SIGNED_DIGITS
+        accsPerChunk = (1 << (bitsPerChunk - 1)) + 1;
+#else
+        accsPerChunk = 1 << bitsPerChunk;
+#endif
+        if (windowsMemory() <= memoryBudget || sortedMemory() <= sortedBudget)
+            break;
     }
+}
 
-    bitsPerChunk = aptos::log2((uint32_t)(n / PME2_PACK_FACTOR));
+template <typename Curve>
+bool ParallelMultiexp<Curve>::useBatchAffine()
+{
+    return bitsPerChunk >= PME2_BATCH_AFFINE_MIN_CHUNK_SIZE_BITS;
+}
 
-    if (bitsPerChunk > PME2_MAX_CHUNK_SIZE_BITS)
-        bitsPerChunk = PME2_MAX_CHUNK_SIZE_BITS;
-    if (bitsPerChunk < PME2_MIN_CHUNK_SIZE_BITS)
-        bitsPerChunk = PME2_MIN_CHUNK_SIZE_BITS;
-    nChunks      = ((scalarSize * 8 - 1) / bitsPerChunk) + 1;
+template <typename Curve>
+void ParallelMultiexp<Curve>::initAffineAccs()
+{
+    uint64_t batchSize = std::clamp<uint64_t>(accsPerChunk >> 4,
+                                              PME2_MIN_AFFINE_BATCH_SIZE,
+                                              PME2_MAX_AFFINE_BATCH_SIZE);
+
+    affineBatches.clear();
+    affineBatches.reserve(nThreads);
+    for (uint64_t t = 0; t < nThreads; t++)
+    {
+        affineBatches.emplace_back(g);
+    }
+
+    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, nThreads),
+                      [&](auto range)
+                      {
+                          for (auto t = range.begin(); t < range.end(); ++t)
+                          {
+                              for (uint64_t i = 0; i < accsPerChunk; i++)
+                              {
+                                  g.copy(affineAccs[t * accsPerChunk + i],
+                                         g.zeroAffine());
+                              }
+                              affineBatches[t].init(
+                                  affineAccs + t * accsPerChunk, accsPerChunk,
+                                  batchSize);
+                          }
+                      });
+
+    for (uint64_t i = 0; i < accsPerChunk; i++)
+    {
+        g.copy(accs[i].p, g.zero());
+    }
+}
+
+template <typename Curve>
+uint64_t ParallelMultiexp<Curve>::getBits(uint64_t scalarIdx, uint64_t bitStart,
+                                          uint64_t nBits)
+{
+    if (bitStart >= scalarSize * 8)
+        return 0;
+
+    uint8_t* scalar    = scalars + scalarIdx * scalarSize;
+    uint64_t byteStart = bitStart / 8;
+    uint64_t v         = 0;
+    if (byteStart + 8 <= scalarSize)
+        v = *(uint64_t*)(scalar + byteStart);
+    else
+        memcpy(&v, scalar + byteStart, scalarSize - byteStart);
+    v = v >> (bitStart - byteStart * 8);
+    return v & ((uint64_t(1) << nBits) - 1);
+}
+
+template <typename Curve>
+int64_t ParallelMultiexp<Curve>::getChunk(uint64_t scalarIdx, uint64_t chunkIdx)
+{
+    if (plan)
+    {
+        if (chunkIdx >= plan->nChunks)
+            return 0;
+        uint64_t idx = scalarIdx < nBases
+                           ? planOffset + scalarIdx
+                           : plan->n + planOffset + scalarIdx - nBases;
+        return plan->digits[chunkIdx * plan->nScalars() + idx];
+    }
+
+    uint64_t bitStart = chunkIdx * bitsPerChunk;
+#if PME2_SIGNED_DIGITS
+    // The top bit of the previous window is borrowed as a carry in, and a set
+    // top bit in this window is paid back by the next one:
+    //   d = w + b[bitStart - 1] - 2^bitsPerChunk * b[bitStart + bitsPerChunk - 1]
+    uint64_t v = bitStart == 0
+                     ? getBits(scalarIdx, 0, bitsPerChunk) << 1
+                     : getBits(scalarIdx, bitStart - 1, bitsPerChunk + 1);
+    int64_t  d = int64_t((v >> 1) + (v & 1));
+    if (v >> bitsPerChunk)
+        d -= int64_t(1) << bitsPerChunk;
+#else
+    int64_t d = int64_t(getBits(scalarIdx, bitStart, bitsPerChunk));
+#endif
+    if (glv && glvNeg[scalarIdx])
+        d = -d;
+    return d;
+}
+
+// Number of windows needed to cover the scalars. With signed digits an extra
+// window is needed only if the last one can end in a borrow, which is not the
+// case for field elements where the top bits are always zero.
+template <typename Curve>
+uint64_t ParallelMultiexp<Curve>::getNumChunks()
+{
+    uint64_t nBits   = scalarSize * 8;
+    uint64_t nChunks = ((nBits - 1) / bitsPerChunk) + 1;
+#if PME2_SIGNED_DIGITS
+    uint64_t topBit = nChunks * bitsPerChunk - 1;
+    if (topBit < nBits)
+    {
+        std::atomic<bool> carry(false);
+        tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, nPoints()),
+                          [&](auto range)
+                          {
+                              for (auto i = range.begin();
+                                   i < range.end() && !carry; ++i)
+                              {
+                                  if (getBits(scalarIndex(i), topBit, 1))
+                                      carry = true;
+                              }
+                          });
+        if (carry)
+            return nChunks + 1;
+    }
+#endif
+    return nChunks;
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::addToAcc(int idThread, int64_t chunkValue,
+                                       typename Curve::PointAffine& base)
+{
+    if (chunkValue > 0)
+    {
+        g.add(accs[idThread * accsPerChunk + chunkValue].p,
+              accs[idThread * accsPerChunk + chunkValue].p, base);
+    }
+    else if (chunkValue < 0)
+    {
+        g.sub(accs[idThread * accsPerChunk - chunkValue].p,
+              accs[idThread * accsPerChunk - chunkValue].p, base);
+    }
+}
+
+// go over all the numbers (windowed numbered) in the window/chunk and add them
+// to their corresponding index
+template <typename Curve>
+void ParallelMultiexp<Curve>::processChunk(uint64_t idChunk)
+{
+    // #pragma omp parallel for
+    //     for (uint64_t i = 0; i < n; i++)
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, nCopies * nPoints()),
+        [&](tbb::blocked_range<std::uint64_t> range)
+        {
+            for (auto i = range.begin(); i < range.end(); ++i)
+
+            {
+                uint64_t copy;
+                uint64_t idx;
+                pointAt(i, copy, idx);
+                int64_t chunkValue = getChunk(idx, copy * nChunks + idChunk);
+                if (chunkValue == 0)
+                    continue;
+
+                typename Curve::PointAffine  tmp;
+                typename Curve::PointAffine& base = getBase(copy, idx, tmp);
+                if (g.isZero(base))
+                    continue;
+
+                int idThread = tbb::this_task_arena::current_thread_index();
+
+                addToAcc(idThread, chunkValue, base);
+            }
+        });
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::processChunk(uint64_t idChunk, uint64_t nX,
+                                           uint64_t size[])
+{
+    // #pragma omp parallel for
+    //             for (uint64_t i = 0; i < n; i++)
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, n),
+        [&](auto range)
+        {
+            for (auto i = range.begin(); i < range.end(); i++)
+            {
+                uint mod = i % nX;
+                uint len = size[mod] - 1;
+                if (i < 0 || i > len * nX + mod)
+                    continue;
+                if (g.isZero(bases[i]))
+                    continue;
+
+                int idThread = tbb::this_task_arena::current_thread_index();
+
+                int64_t chunkValue = getChunk(i, idChunk);
+
+                addToAcc(idThread, chunkValue, bases[i]);
+            }
+        });
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::processChunkBatchAffine(uint64_t idChunk)
+{
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, nCopies * nPoints()),
+        [&](auto range)
+        {
+            int idThread = tbb::this_task_arena::current_thread_index();
+            AffineBucketBatch<Curve>& batch = affineBatches[idThread];
+
+            for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                uint64_t copy;
+                uint64_t idx;
+                pointAt(i, copy, idx);
+                int64_t chunkValue = getChunk(idx, copy * nChunks + idChunk);
+                if (chunkValue == 0)
+                    continue;
+
+                typename Curve::PointAffine  tmp;
+                typename Curve::PointAffine& base = getBase(copy, idx, tmp);
+
+                if (chunkValue > 0)
+                    batch.add(chunkValue, base, false);
+                else
+                    batch.add(-chunkValue, base, true);
+            }
+        });
+
+    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, nThreads),
+                      [&](auto range)
+                      {
+                          for (auto t = range.begin(); t < range.end(); ++t)
+                          {
+                              affineBatches[t].finish();
+                          }
+                      });
+}
+
+// This function takes all chunks and accumulate them to the first chunk's
+// indexes
+template <typename Curve>
+void ParallelMultiexp<Curve>::packThreads()
+{
+    // #pragma omp parallel for
+    //     for (uint64_t i = 0; i < accsPerChunk; i++)
+    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, accsPerChunk),
+                      [&](auto range)
+                      {
+                          for (auto i = range.begin(); i < range.end(); ++i)
+                          {
+                              for (uint64_t j = 1; j < nThreads; j++)
+                              {
+                                  if (!g.isZero(accs[j * accsPerChunk + i].p))
+                                  {
+                                      g.add(accs[i].p, accs[i].p,
+                                            accs[j * accsPerChunk + i].p);
+                                      g.copy(accs[j * accsPerChunk + i].p,
+                                             g.zero());
+                                  }
+                              }
+                          }
+                      });
+}
+
+// Same as packThreads() for the affine per thread buckets, the sums go to
+// the projective accs[0, accsPerChunk).
+template <typename Curve>
+void ParallelMultiexp<Curve>::packThreadsBatchAffine()
+{
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, accsPerChunk),
+        [&](auto range)
+        {
+            for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                for (uint64_t j = 0; j < nThreads; j++)
+                {
+                    typename Curve::PointAffine& acc =
+                        affineAccs[j * accsPerChunk + i];
+                    if (!g.isZero(acc))
+                    {
+                        g.add(accs[i].p, accs[i].p, acc);
+                        g.copy(acc, g.zeroAffine());
+                    }
+                }
+            }
+        });
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::reduce(typename Curve::Point& res, uint64_t nBits)
+{
+    if (nBits == 1)
+    {
+        g.copy(res, accs[1].p);
+        g.copy(accs[1].p, g.zero());
+        return;
+    }
+    uint64_t ndiv2 = 1 << (nBits - 1);
+
+    // Done with before the recursion, so every level uses the same one.
+    PaddedPoint* sall = ws->sall.get<PaddedPoint>(nThreads);
+
+    memset(sall, 0, sizeof(PaddedPoint) * nThreads);
+
+    // #pragma omp parallel for
+    //     for (uint64_t i = 1; i < ndiv2; i++)
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, ndiv2),
+        [&](auto range)
+        {
+            for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                int idThread = tbb::this_task_arena::current_thread_index();
+                if (!g.isZero(accs[ndiv2 + i].p))
+                {
+                    g.add(accs[i].p, accs[i].p, accs[ndiv2 + i].p);
+                    g.add(sall[idThread].p, sall[idThread].p,
+                          accs[ndiv2 + i].p);
+                    g.copy(accs[ndiv2 + i].p, g.zero());
+                }
+            }
+        });
+
+    for (u_int32_t i = 0; i < nThreads; i++)
+    {
+        g.add(accs[ndiv2].p, accs[ndiv2].p, sall[i].p);
+    }
+
+    typename Curve::Point p1;
+    reduce(p1, nBits - 1);
+
+    for (u_int32_t i = 0; i < nBits - 1; i++)
+        g.dbl(accs[ndiv2].p, accs[ndiv2].p);
+    g.add(res, p1, accs[ndiv2].p);
+    g.copy(accs[ndiv2].p, g.zero());
+    // delete[] sall;
+}
+
+// Computes sum(k * accs[k]) for the packed accumulators of one window.
+template <typename Curve>
+void ParallelMultiexp<Curve>::reduceChunk(typename Curve::Point& res)
+{
+#if PME2_SIGNED_DIGITS
+    // reduce() handles the power of two range [0, 2^(bitsPerChunk-1)), the
+    // last bucket holds the digits of magnitude exactly 2^(bitsPerChunk-1).
+    uint64_t              nBits = bitsPerChunk - 1;
+    typename Curve::Point top;
+    g.copy(top, accs[uint64_t(1) << nBits].p);
+    g.copy(accs[uint64_t(1) << nBits].p, g.zero());
+    for (uint64_t i = 0; i < nBits; i++)
+        g.dbl(top, top);
+    reduce(res, nBits);
+    g.add(res, res, top);
+#else
+    reduce(res, bitsPerChunk);
+#endif
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
+                                       typename Curve::PointAffine* _bases,
+                                       uint8_t* _scalars, uint64_t _scalarSize,
+                                       uint64_t _n, uint64_t _nThreads)
+{
+    reset();
+    nThreads = tbb::this_task_arena::max_concurrency();
+
+    bases      = _bases;
+    nBases     = _n;
+    scalars    = _scalars;
+    scalarSize = _scalarSize;
+    n          = _n;
+
+    if (n == 0)
+    {
+        g.copy(r, g.zero());
+        return;
+    }
+    if (n == 1)
+    {
+        g.mulByScalar(r, bases[0], scalars, scalarSize);
+        return;
+    }
+
+    classifyScalars();
+    if (glvAllowed(scalarSize))
+    {
+        splitScalars();
+    }
+
+    bitsPerChunk = chooseBitsPerChunk(nPoints());
+    fitMemoryBudget();
+    nChunks = getNumChunks();
+
+    multiexpChunks(r);
+}
+
+// Runs the windows once bases, scalars, bitsPerChunk and nChunks are set.
+// Computes the window idChunk of the points [begin, end) into res with a
+// private set of buckets, reduced with a running sum.
+template <typename Curve>
+void ParallelMultiexp<Curve>::processWindow(typename Curve::Point& res,
+                                            uint64_t idChunk, uint64_t begin,
+                                            uint64_t end)
+{
+    typename Curve::Point sum;
+    g.copy(sum, g.zero());
+    g.copy(res, g.zero());
+
+    // Called isolated, so the thread runs no other window until this one is
+    // done and its buckets are free.
+    uint64_t idThread = tbb::this_task_arena::current_thread_index();
+
+    if (useBatchAffine())
+    {
+        typename Curve::PointAffine* buckets =
+            ws->buckets.get<typename Curve::PointAffine>(nThreads *
+                                                         accsPerChunk) +
+            idThread * accsPerChunk;
+        for (uint64_t k = 0; k < accsPerChunk; k++)
+            g.copy(buckets[k], g.zeroAffine());
+
+        AffineBucketBatch<Curve> batch(g);
+        batch.init(buckets, accsPerChunk,
+                   std::clamp<uint64_t>(accsPerChunk >> 4,
+                                        PME2_MIN_AFFINE_BATCH_SIZE,
+                                        PME2_MAX_AFFINE_BATCH_SIZE));
+
+        for (uint64_t i = begin; i < end; i++)
+        {
+            uint64_t copy;
+            uint64_t idx;
+            pointAt(i, copy, idx);
+            int64_t chunkValue = getChunk(idx, copy * nChunks + idChunk);
+            if (chunkValue == 0)
+                continue;
+
+            typename Curve::PointAffine  tmp;
+            typename Curve::PointAffine& base = getBase(copy, idx, tmp);
+
+            if (chunkValue > 0)
+                batch.add(chunkValue, base, false);
+            else
+                batch.add(-chunkValue, base, true);
+        }
+        batch.finish();
+
+        for (uint64_t k = accsPerChunk - 1; k > 0; k--)
+        {
+            if (!g.isZero(buckets[k]))
+                g.add(sum, sum, buckets[k]);
+            g.add(res, res, sum);
+        }
+    }
+    else
+    {
+        typename Curve::Point* buckets =
+            ws->buckets.get<typename Curve::Point>(nThreads * accsPerChunk) +
+            idThread * accsPerChunk;
+        for (uint64_t k = 0; k < accsPerChunk; k++)
+            g.copy(buckets[k], g.zero());
+
+        for (uint64_t i = begin; i < end; i++)
+        {
+            uint64_t copy;
+            uint64_t idx;
+            pointAt(i, copy, idx);
+            int64_t chunkValue = getChunk(idx, copy * nChunks + idChunk);
+            if (chunkValue == 0)
+                continue;
+
+            typename Curve::PointAffine  tmp;
+            typename Curve::PointAffine& base = getBase(copy, idx, tmp);
+            if (g.isZero(base))
+                continue;
+
+            if (chunkValue > 0)
+                g.add(buckets[chunkValue], buckets[chunkValue], base);
+            else
+                g.sub(buckets[-chunkValue], buckets[-chunkValue], base);
+        }
+
+        for (uint64_t k = accsPerChunk - 1; k > 0; k--)
+        {
+            g.add(sum, sum, buckets[k]);
+            g.add(res, res, sum);
+        }
+    }
+}
+
+// All the windows at once: nChunks * nSegments independent tasks, only the
+// sum of the segments of each window is done afterwards.
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexpWindows(
+    typename Curve::Point* chunkResults)
+{
+    uint64_t nPoints   = nCopies * this->nPoints();
+    uint64_t nSegments = (nThreads + nChunks - 1) / nChunks;
+
+    // A segment costs a reduction of its buckets, keep them worth it.
+    nSegments = std::min(nSegments, std::max<uint64_t>(1, nPoints / accsPerChunk));
+    uint64_t segmentSize = (nPoints + nSegments - 1) / nSegments;
+
+    std::vector<typename Curve::Point> results(nChunks * nSegments);
+
+    // The tasks take their buckets from here, it must not grow under them.
+    ws->buckets.reserve(nThreads * accsPerChunk * bucketSize());
+
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, nChunks * nSegments, 1),
+        [&](auto range)
+        {
+            for (auto t = range.begin(); t < range.end(); ++t)
+            {
+                uint64_t idChunk = t / nSegments;
+                uint64_t segment = t - idChunk * nSegments;
+                uint64_t begin   = segment * segmentSize;
+                uint64_t end     = std::min(nPoints, begin + segmentSize);
+                tbb::this_task_arena::isolate(
+                    [&] { processWindow(results[t], idChunk, begin, end); });
+            }
+        });
+
+    for (uint64_t i = 0; i < nChunks; i++)
+    {
+        g.copy(chunkResults[i], results[i * nSegments]);
+        for (uint64_t j = 1; j < nSegments; j++)
+            g.add(chunkResults[i], chunkResults[i], results[i * nSegments + j]);
+    }
+}
+
+// Computes sum(k * buckets[k]) splitting the buckets in segments [lo, hi),
+// each one adds sum((k - lo + 1) * buckets[k]) + (lo - 1) * sum(buckets[k]).
+template <typename Curve>
+template <typename Bucket>
+void ParallelMultiexp<Curve>::reduceBuckets(typename Curve::Point& res,
+                                            Bucket*                buckets)
+{
+    uint64_t nSegments =
+        std::min<uint64_t>(PME2_SORTED_REDUCE_SEGMENTS, accsPerChunk - 1);
+    uint64_t segmentSize = (accsPerChunk - 1 + nSegments - 1) / nSegments;
+
+    std::vector<typename Curve::Point> results(nSegments);
+
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, nSegments, 1),
+        [&](auto range)
+        {
+            for (auto s = range.begin(); s < range.end(); ++s)
+            {
+                uint64_t lo = 1 + s * segmentSize;
+                uint64_t hi = std::min(accsPerChunk, lo + segmentSize);
+
+                typename Curve::Point sum;
+                typename Curve::Point acc;
+                g.copy(sum, g.zero());
+                g.copy(acc, g.zero());
+                for (uint64_t k = hi; k > lo; k--)
+                {
+                    if (!g.isZero(buckets[k - 1]))
+                        g.add(sum, sum, buckets[k - 1]);
+                    g.add(acc, acc, sum);
+                }
+
+                typename Curve::Point p;
+                uint64_t              m = lo - 1;
+                g.mulByScalar(p, sum, (uint8_t*)&m, sizeof(m));
+                g.add(results[s], acc, p);
+            }
+        });
+
+    g.copy(res, g.zero());
+    for (uint64_t s = 0; s < nSegments; s++)
+        g.add(res, res, results[s]);
+}
+
+// Memory bounded mode: the points of every window are counting sorted by
+// bucket, so that threads own disjoint ranges of a single set of buckets
+// instead of having a set each.
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexpSorted(
+    typename Curve::Point* chunkResults)
+{
+    const uint32_t NEG_FLAG = 0x80000000;
+
+    uint64_t nPoints = nCopies * this->nPoints();
+    assert(nPoints < NEG_FLAG);
+
+    std::vector<uint32_t>              sorted(nPoints);
+    std::vector<uint32_t>              starts(accsPerChunk + 1);
+    std::vector<std::atomic<uint32_t>> offsets(accsPerChunk);
+
+    std::vector<typename Curve::PointAffine> affineBuckets;
+    std::vector<typename Curve::Point>       buckets;
+    if (useBatchAffine())
+        affineBuckets.resize(accsPerChunk);
+    else
+        buckets.resize(accsPerChunk);
+
+    auto digit = [&](uint64_t i, uint64_t idChunk)
+    {
+        uint64_t copy;
+        uint64_t idx;
+        pointAt(i, copy, idx);
+        return getChunk(idx, copy * nChunks + idChunk);
+    };
+
+    for (uint64_t idChunk = 0; idChunk < nChunks; idChunk++)
+    {
+        for (auto& o : offsets)
+            o = 0;
+
+        tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, nPoints),
+                          [&](auto range)
+                          {
+                              for (auto i = range.begin(); i < range.end(); ++i)
+                              {
+                                  int64_t d = digit(i, idChunk);
+                                  if (d != 0)
+                                      offsets[d > 0 ? d : -d]++;
+                              }
+                          });
+
+        starts[0] = 0;
+        for (uint64_t k = 0; k < accsPerChunk; k++)
+        {
+            starts[k + 1] = starts[k] + offsets[k];
+            offsets[k]    = starts[k];
+        }
+
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint64_t>(0, nPoints),
+            [&](auto range)
+            {
+                for (auto i = range.begin(); i < range.end(); ++i)
+                {
+                    int64_t d = digit(i, idChunk);
+                    if (d > 0)
+                        sorted[offsets[d]++] = i;
+                    else if (d < 0)
+                        sorted[offsets[-d]++] = i | NEG_FLAG;
+                }
+            });
+
+        tbb::parallel_for(
+            tbb::blocked_range<std::uint64_t>(1, accsPerChunk, 256),
+            [&](auto range)
+            {
+                uint64_t lo = range.begin();
+                uint64_t hi = range.end();
+
+                if (useBatchAffine())
+                {
+                    for (uint64_t k = lo; k < hi; k++)
+                        g.copy(affineBuckets[k], g.zeroAffine());
+
+                    AffineBucketBatch<Curve> batch(g);
+                    batch.init(affineBuckets.data() + lo, hi - lo,
+                               std::clamp<uint64_t>(hi - lo,
+                                                    PME2_MIN_AFFINE_BATCH_SIZE,
+                                                    PME2_MAX_AFFINE_BATCH_SIZE));
+
+                    // Takes the points round robin from the buckets, so that
+                    // consecutive additions rarely go to the same one.
+                    std::vector<uint64_t> active;
+                    for (uint64_t k = lo; k < hi; k++)
+                    {
+                        if (starts[k] < starts[k + 1])
+                            active.push_back(k);
+                    }
+                    for (uint64_t round = 0; !active.empty(); round++)
+                    {
+                        uint64_t nActive = 0;
+                        for (uint64_t k : active)
+                        {
+                            uint32_t e = sorted[starts[k] + round];
+                            uint64_t copy;
+                            uint64_t idx;
+                            pointAt(e & ~NEG_FLAG, copy, idx);
+                            typename Curve::PointAffine  tmp;
+                            typename Curve::PointAffine& base =
+                                getBase(copy, idx, tmp);
+                            batch.add(k - lo, base, e & NEG_FLAG);
+
+                            if (starts[k] + round + 1 < starts[k + 1])
+                                active[nActive++] = k;
+                        }
+                        active.resize(nActive);
+                    }
+                    batch.finish();
+                }
+                else
+                {
+                    for (uint64_t k = lo; k < hi; k++)
+                    {
+                        g.copy(buckets[k], g.zero());
+                        for (uint64_t j = starts[k]; j < starts[k + 1]; j++)
+                        {
+                            uint32_t e = sorted[j];
+                            uint64_t copy;
+                            uint64_t idx;
+                            pointAt(e & ~NEG_FLAG, copy, idx);
+                            typename Curve::PointAffine  tmp;
+                            typename Curve::PointAffine& base =
+                                getBase(copy, idx, tmp);
+                            if (g.isZero(base))
+                                continue;
+                            if (e & NEG_FLAG)
+                                g.sub(buckets[k], buckets[k], base);
+                            else
+                                g.add(buckets[k], buckets[k], base);
+                        }
+                    }
+                }
+            });
+
+        if (useBatchAffine())
+            reduceBuckets(chunkResults[idChunk], affineBuckets.data());
+        else
+            reduceBuckets(chunkResults[idChunk], buckets.data());
+    }
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexpChunks(typename Curve::Point& r)
+{
+#if PME2_SIGNED_DIGITS
+    accsPerChunk = (1 << (bitsPerChunk - 1)) + 1;
+#else
     accsPerChunk = 1 << bitsPerChunk; // In the chunks last bit is always zero.
+#endif
 
-    typename Curve::Point* chunkResults = new typename Curve::Point[nChunks];
-    MAKE_SCOPE_EXIT(delete_chunkResults) { delete[] chunkResults; };
+    typename Curve::Point sparseSum;
+    sumSparse(sparseSum);
+    if (nPoints() == 0)
+    {
+        g.copy(r, sparseSum);
+        return;
+    }
 
-    accs = new PaddedPoint[nThreads * accsPerChunk];
-    MAKE_SCOPE_EXIT(delete_accs) { delete[] accs; };
-    // std::cout << "InitTrees " << "\n";
-    initAccs();
+    typename Curve::Point* chunkResults =
+        ws->chunkResults.get<typename Curve::Point>(nChunks);
 
-    for (uint64_t i = 0; i < nChunks; i++)
+    if (memoryBudget != 0 && windowsMemory() > memoryBudget)
     {
-        // std::cout << "process chunks " << i << "\n";
+        multiexpSorted(chunkResults);
+    }
+    else if (PME2_WINDOW_PARALLEL)
+    {
+        multiexpWindows(chunkResults);
+    }
+    else if (useBatchAffine())
+    {
+        affineAccs = ws->buckets.get<typename Curve::PointAffine>(
+            nThreads * accsPerChunk);
+        accs = ws->accs.get<PaddedPoint>(accsPerChunk);
 
-        processChunk(i);
-        // std::cout << "pack " << i << "\n";
-        packThreads();
-        // std::cout << "reduce " << i << "\n";
-        reduce(chunkResults[i], bitsPerChunk);
+        initAffineAccs();
+
+        for (uint64_t i = 0; i < nChunks; i++)
+        {
+            processChunkBatchAffine(i);
+            packThreadsBatchAffine();
+            reduceChunk(chunkResults[i]);
+        }
+    }
+    else
+    {
+        accs = ws->buckets.get<PaddedPoint>(nThreads * accsPerChunk);
+        // std::cout << "InitTrees " << "\n";
+        initAccs();
+
+        for (uint64_t i = 0; i < nChunks; i++)
+        {
+            // std::cout << "process chunks " << i << "\n";
+
+            processChunk(i);
+            // std::cout << "pack " << i << "\n";
+            packThreads();
+            // std::cout << "reduce " << i << "\n";
+            reduceChunk(chunkResults[i]);
+        }
     }
 
     // delete[] accs;
@@ -290,6 +1619,7 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
             g.dbl(r, r);
         g.add(r, r, chunkResults[j]);
     }
+    g.add(r, r, sparseSum);
 
     // delete[] chunkResults;
 }
@@ -301,9 +1631,11 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
                                        uint64_t _n, uint64_t nx, uint64_t x[],
                                        uint64_t _nThreads)
 {
+    reset();
     nThreads = tbb::this_task_arena::max_concurrency();
 
     bases      = _bases;
+    nBases     = _n;
     scalars    = _scalars;
     scalarSize = _scalarSize;
     n          = _n;
@@ -323,14 +1655,17 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
         bitsPerChunk = PME2_MAX_CHUNK_SIZE_BITS;
     if (bitsPerChunk < PME2_MIN_CHUNK_SIZE_BITS)
         bitsPerChunk = PME2_MIN_CHUNK_SIZE_BITS;
-    nChunks      = ((scalarSize * 8 - 1) / bitsPerChunk) + 1;
+    nChunks = getNumChunks();
+#if PME2_SIGNED_DIGITS
+    accsPerChunk = (1 << (bitsPerChunk - 1)) + 1;
+#else
     accsPerChunk = 1 << bitsPerChunk; // In the chunks last bit is always zero.
+#endif
 
-    typename Curve::Point* chunkResults = new typename Curve::Point[nChunks];
-    MAKE_SCOPE_EXIT(delete_chunkResults) { delete[] chunkResults; };
+    typename Curve::Point* chunkResults =
+        ws->chunkResults.get<typename Curve::Point>(nChunks);
 
-    accs = new PaddedPoint[nThreads * accsPerChunk];
-    MAKE_SCOPE_EXIT(delete_accs) { delete[] accs; };
+    accs = ws->buckets.get<PaddedPoint>(nThreads * accsPerChunk);
 
     // std::cout << "InitTrees " << "\n";
     initAccs();
@@ -341,7 +1676,7 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
         // std::cout << "pack " << i << "\n";
         packThreads();
         // std::cout << "reduce " << i << "\n";
-        reduce(chunkResults[i], bitsPerChunk);
+        reduceChunk(chunkResults[i]);
     }
 
     // delete[] accs;
@@ -357,4 +1692,588 @@ void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
     // delete[] chunkResults;
 }
 
+template <typename Curve>
+void ParallelMultiexp<Curve>::precompute(FixedBaseTable<Curve>&       table,
+                                         typename Curve::PointAffine* _bases,
+                                         uint64_t _n, uint64_t _scalarSize,
+                                         uint64_t maxCopies)
+{
+    table.n          = _n;
+    table.scalarSize = _scalarSize;
+    table.glv        = glvAllowed(_scalarSize);
+
+    uint64_t nScalars   = table.glv ? 2 * _n : _n;
+    uint64_t scalarBits = (table.glv ? PME2_GLV_SCALAR_SIZE : _scalarSize) * 8;
+    if (maxCopies == 0)
+        maxCopies = 1;
+
+    // Field elements and GLV halves leave the top bit clear, so signed digits
+    // need no extra window. Scalars that do are sent to the plain multiexp.
+    // The windows are kept small enough to be planned.
+    table.bitsPerChunk   = std::min<uint64_t>(
+        chooseBitsPerChunk(nScalars * maxCopies), PME2_PLAN_MAX_CHUNK_SIZE_BITS);
+    uint64_t totalChunks = (scalarBits - 1) / table.bitsPerChunk + 1;
+    uint64_t nCopies     = std::min(maxCopies, totalChunks);
+    table.chunksPerCopy  = (totalChunks + nCopies - 1) / nCopies;
+    nCopies = (totalChunks + table.chunksPerCopy - 1) / table.chunksPerCopy;
+
+    uint64_t shift = table.chunksPerCopy * table.bitsPerChunk;
+
+    table.storage.resize((nCopies - 1) * _n);
+    table.copies.resize(nCopies);
+    table.copies[0] = _bases;
+    for (uint64_t j = 1; j < nCopies; j++)
+    {
+        table.copies[j] = table.storage.data() + (j - 1) * _n;
+    }
+
+    // Blocks of bases are shifted copy by copy, each copy of a block made
+    // affine with one batch inversion.
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, _n, BATCH_INVERSE_CHUNK),
+        [&](auto range)
+        {
+            std::vector<typename Curve::Point> p(range.size());
+            for (auto i = range.begin(); i < range.end(); ++i)
+            {
+                g.copy(p[i - range.begin()], _bases[i]);
+            }
+            for (uint64_t j = 1; j < nCopies; j++)
+            {
+                for (auto& q : p)
+                {
+                    for (uint64_t k = 0; k < shift; k++)
+                        g.dbl(q, q);
+                }
+                g.batchNormalize(table.copies[j] + range.begin(), p.data(),
+                                 p.size());
+            }
+        },
+        tbb::simple_partitioner());
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexp(typename Curve::Point& r,
+                                       FixedBaseTable<Curve>& table,
+                                       uint8_t*               _scalars)
+{
+    if (table.nCopies() <= 1)
+    {
+        multiexp(r, table.copies[0], _scalars, table.scalarSize, table.n);
+        return;
+    }
+
+    reset();
+    nThreads = tbb::this_task_arena::max_concurrency();
+
+    bases      = table.copies[0];
+    nBases     = table.n;
+    scalars    = _scalars;
+    scalarSize = table.scalarSize;
+    n          = table.n;
+
+    classifyScalars();
+    if (table.glv && !splitScalars())
+    {
+        multiexp(r, table.copies[0], _scalars, table.scalarSize, table.n);
+        return;
+    }
+
+    bitsPerChunk = table.bitsPerChunk;
+    if (getNumChunks() > table.nCopies() * table.chunksPerCopy)
+    {
+        glv = false;
+        multiexp(r, table.copies[0], _scalars, table.scalarSize, table.n);
+        return;
+    }
+
+    copies  = table.copies.data();
+    nCopies = table.nCopies();
+    nChunks = table.chunksPerCopy;
+
+    multiexpChunks(r);
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::makePlan(ScalarPlan& _plan, uint8_t* _scalars,
+                                       uint64_t _scalarSize, uint64_t _n,
+                                       uint64_t _bitsPerChunk,
+                                       uint64_t minChunks)
+{
+    reset();
+    nThreads = tbb::this_task_arena::max_concurrency();
+
+    nBases     = _n;
+    scalars    = _scalars;
+    scalarSize = _scalarSize;
+    n          = _n;
+
+    classifyScalars();
+    if (glvAllowed(scalarSize))
+    {
+        splitScalars();
+    }
+
+    if (_bitsPerChunk)
+    {
+        bitsPerChunk = _bitsPerChunk;
+    }
+    else
+    {
+        bitsPerChunk = chooseBitsPerChunk(nPoints());
+        fitMemoryBudget();
+    }
+    bitsPerChunk = std::min<uint64_t>(bitsPerChunk, PME2_PLAN_MAX_CHUNK_SIZE_BITS);
+    nChunks = std::max(getNumChunks(), minChunks);
+
+    _plan.scalars      = _scalars;
+    _plan.scalarSize   = _scalarSize;
+    _plan.n            = _n;
+    _plan.glv          = glv;
+    _plan.bitsPerChunk = bitsPerChunk;
+    _plan.nChunks      = nChunks;
+    _plan.digits.resize(nChunks * n);
+
+    // The digits of the scalars sorted out are never read.
+    tbb::parallel_for(tbb::blocked_range<std::uint64_t>(0, nPoints()),
+                      [&](auto range)
+                      {
+                          for (auto i = range.begin(); i < range.end(); ++i)
+                          {
+                              uint64_t idx = scalarIndex(i);
+                              for (uint64_t w = 0; w < nChunks; w++)
+                                  _plan.digits[w * n + idx] = getChunk(idx, w);
+                          }
+                      });
+}
+
+// Sets up the multiexp of the scalars [offset, offset + _n) of the plan.
+// False when the plan was made for other window sizes.
+template <typename Curve>
+bool ParallelMultiexp<Curve>::usePlan(typename Curve::PointAffine* _bases,
+                                      ScalarPlan& _plan, uint64_t offset,
+                                      uint64_t _n)
+{
+    if (_n < 2)
+        return false;
+
+    reset();
+    nThreads = tbb::this_task_arena::max_concurrency();
+
+    bases      = _bases;
+    nBases     = _n;
+    scalars    = _plan.scalars + offset * _plan.scalarSize;
+    scalarSize = _plan.scalarSize;
+    classifyScalars();
+    glv = glvAllowed(scalarSize);
+    n   = glv ? 2 * _n : _n;
+
+    // The windows of the plan were chosen for the count of dense scalars of
+    // all of it, which is close enough for a range of them.
+    bitsPerChunk = _plan.bitsPerChunk;
+    fitMemoryBudget();
+    if (_plan.glv != glv || _plan.bitsPerChunk != bitsPerChunk)
+    {
+        glv = false;
+        return false;
+    }
+
+    plan       = &_plan;
+    planOffset = offset;
+    nChunks    = _plan.nChunks;
+    return true;
+}
+
+template <typename Curve>
+bool ParallelMultiexp<Curve>::usePlan(FixedBaseTable<Curve>& table,
+                                      ScalarPlan& _plan, uint64_t offset)
+{
+    if (table.nCopies() <= 1)
+        return usePlan(table.copies[0], _plan, offset, table.n);
+    if (_plan.glv != table.glv || _plan.bitsPerChunk != table.bitsPerChunk ||
+        _plan.nChunks > table.nCopies() * table.chunksPerCopy)
+    {
+        return false;
+    }
+
+    reset();
+    nThreads = tbb::this_task_arena::max_concurrency();
+
+    bases      = table.copies[0];
+    nBases     = table.n;
+    scalars    = _plan.scalars + offset * _plan.scalarSize;
+    scalarSize = table.scalarSize;
+    classifyScalars();
+
+    glv          = table.glv;
+    n            = glv ? 2 * table.n : table.n;
+    plan         = &_plan;
+    planOffset   = offset;
+    copies       = table.copies.data();
+    nCopies      = table.nCopies();
+    bitsPerChunk = table.bitsPerChunk;
+    nChunks      = table.chunksPerCopy;
+    return true;
+}
+
+// Multiexp of the scalars [offset, offset + _n) of the plan. Falls back to
+// the plain multiexp when the plan was made for other window sizes.
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexp(typename Curve::Point&       r,
+                                       typename Curve::PointAffine* _bases,
+                                       ScalarPlan& _plan, uint64_t offset,
+                                       uint64_t _n)
+{
+    if (!usePlan(_bases, _plan, offset, _n))
+    {
+        multiexp(r, _bases, _plan.scalars + offset * _plan.scalarSize,
+                 _plan.scalarSize, _n);
+        return;
+    }
+    multiexpChunks(r);
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexp(typename Curve::Point& r,
+                                       FixedBaseTable<Curve>& table,
+                                       ScalarPlan& _plan, uint64_t offset)
+{
+    if (usePlan(table, _plan, offset))
+    {
+        multiexpChunks(r);
+    }
+    else if (table.nCopies() <= 1)
+    {
+        multiexp(r, table.copies[0], _plan.scalars + offset * _plan.scalarSize,
+                 _plan.scalarSize, table.n);
+    }
+    else
+    {
+        multiexp(r, table, _plan.scalars + offset * _plan.scalarSize);
+    }
+}
+
+// Multiexps of the same bases with the scalars [offset, offset + _n) of
+// several plans, see multiexpBatch().
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexp(typename Curve::Point*       r,
+                                       typename Curve::PointAffine* _bases,
+                                       ScalarPlan** _plans, uint64_t nPlans,
+                                       uint64_t offset, uint64_t _n)
+{
+    std::vector<std::unique_ptr<ParallelMultiexp>> pms(nPlans);
+    std::vector<uint8_t>                           planned(nPlans);
+    tbb::parallel_for(uint64_t(0), nPlans,
+                      [&](uint64_t v)
+                      {
+                          pms[v] = std::make_unique<ParallelMultiexp>(g, ws);
+                          planned[v] =
+                              pms[v]->usePlan(_bases, *_plans[v], offset, _n);
+                      });
+
+    multiexpBatch(r, pms, planned,
+                  [&](uint64_t v)
+                  {
+                      ParallelMultiexp pm(g, ws);
+                      pm.multiexp(r[v], _bases, *_plans[v], offset, _n);
+                  });
+}
+
+template <typename Curve>
+void ParallelMultiexp<Curve>::multiexp(typename Curve::Point* r,
+                                       FixedBaseTable<Curve>& table,
+                                       ScalarPlan** _plans, uint64_t nPlans,
+                                       uint64_t offset)
+{
+    std::vector<std::unique_ptr<ParallelMultiexp>> pms(nPlans);
+    std::vector<uint8_t>                           planned(nPlans);
+    tbb::parallel_for(uint64_t(0), nPlans,
+                      [&](uint64_t v)
+                      {
+                          pms[v] = std::make_unique<ParallelMultiexp>(g, ws);
+                          planned[v] = pms[v]->usePlan(table, *_plans[v], offset);
+                      });
+
+    multiexpBatch(r, pms, planned,
+                  [&](uint64_t v)
+                  {
+                      ParallelMultiexp pm(g, ws);
+                      pm.multiexp(r[v], table, *_plans[v], offset);
+                  });
+}
+
+// Runs the multiexps set up by usePlan() that share their windows with one
+// window pass over the bases: every task reads a block of bases once and
+// adds it to the buckets of all of them. The rest run one by one, through
+// fallback when their plan could not be used.
+template <typename Curve>
+template <typename Fallback>
+void ParallelMultiexp<Curve>::multiexpBatch(
+    typename Curve::Point*                          r,
+    std::vector<std::unique_ptr<ParallelMultiexp>>& pms,
+    std::vector<uint8_t>& planned, Fallback fallback)
+{
+    reset();
+
+    std::vector<ParallelMultiexp*> batch;
+    std::vector<uint64_t>          batchIdx;
+    for (uint64_t v = 0; v < pms.size(); v++)
+    {
+        if (!planned[v])
+            continue;
+        ParallelMultiexp& pm = *pms[v];
+        if (batch.empty() ||
+            (pm.glv == batch[0]->glv &&
+             pm.bitsPerChunk == batch[0]->bitsPerChunk &&
+             pm.nCopies == batch[0]->nCopies &&
+             (pm.nCopies == 1 || pm.nChunks == batch[0]->nChunks)))
+        {
+            batch.push_back(&pm);
+            batchIdx.push_back(v);
+        }
+    }
+
+    for (uint64_t v = 0; v < pms.size(); v++)
+    {
+        if (!planned[v])
+            fallback(v);
+    }
+    if (batch.empty())
+        return;
+
+    ParallelMultiexp& first = *batch[0];
+    nThreads     = first.nThreads;
+    bases        = first.bases;
+    nBases       = first.nBases;
+    copies       = first.copies;
+    nCopies      = first.nCopies;
+    glv          = first.glv;
+    bitsPerChunk = first.bitsPerChunk;
+#if PME2_SIGNED_DIGITS
+    accsPerChunk = (1 << (bitsPerChunk - 1)) + 1;
+#else
+    accsPerChunk = 1 << bitsPerChunk;
+#endif
+
+    // Plans over the same bases only differ in the number of windows when a
+    // carry needs an extra one, the missing windows read as zero digits.
+    nChunks = 0;
+    for (auto pm : batch)
+        nChunks = std::max(nChunks, pm->nChunks);
+
+    uint64_t k = batch.size();
+    if (k == 1 || !PME2_WINDOW_PARALLEL ||
+        (memoryBudget != 0 && k * windowsMemory() > memoryBudget))
+    {
+        batch.clear();
+    }
+
+    for (uint64_t v = 0; v < pms.size(); v++)
+    {
+        if (planned[v] &&
+            std::find(batch.begin(), batch.end(), pms[v].get()) == batch.end())
+        {
+            pms[v]->multiexpChunks(r[v]);
+        }
+    }
+    if (batch.empty())
+        return;
+
+    std::vector<typename Curve::Point> sparseSums(k);
+    for (uint64_t v = 0; v < k; v++)
+    {
+        batch[v]->accsPerChunk = accsPerChunk;
+        batch[v]->sumSparse(sparseSums[v]);
+    }
+
+    uint64_t nPositions = nCopies * (glv ? 2 : 1) * nBases;
+    uint64_t nSegments  = (nThreads + nChunks - 1) / nChunks;
+    nSegments = std::min(nSegments,
+                         std::max<uint64_t>(1, nPositions / accsPerChunk));
+    uint64_t segmentSize = (nPositions + nSegments - 1) / nSegments;
+
+    std::vector<typename Curve::Point> results(nChunks * nSegments * k);
+
+    // The tasks take their buckets from here, it must not grow under them.
+    ws->buckets.reserve(nThreads * k * accsPerChunk * bucketSize());
+
+    tbb::parallel_for(
+        tbb::blocked_range<std::uint64_t>(0, nChunks * nSegments, 1),
+        [&](auto range)
+        {
+            for (auto t = range.begin(); t < range.end(); ++t)
+            {
+                uint64_t idChunk = t / nSegments;
+                uint64_t segment = t - idChunk * nSegments;
+                uint64_t begin   = segment * segmentSize;
+                uint64_t end     = std::min(nPositions, begin + segmentSize);
+                tbb::this_task_arena::isolate(
+                    [&] {
+                        processWindowBatch(batch, &results[t * k], idChunk,
+                                           begin, end);
+                    });
+            }
+        });
+
+    for (uint64_t v = 0; v < k; v++)
+    {
+        typename Curve::Point& res = r[batchIdx[v]];
+        g.copy(res, g.zero());
+        for (int64_t i = nChunks - 1; i >= 0; i--)
+        {
+            for (uint64_t b = 0; b < bitsPerChunk; b++)
+                g.dbl(res, res);
+            for (uint64_t s = 0; s < nSegments; s++)
+                g.add(res, res, results[(i * nSegments + s) * k + v]);
+        }
+        g.add(res, res, sparseSums[v]);
+    }
+}
+
+// Calls add(v, digit, base) for the points of every multiexp v of the batch
+// in the positions [begin, end) of window idChunk. Positions run over the
+// bases of every copy, and of the endomorphism after them with GLV, in
+// blocks of PME2_BATCH_BLOCK_SIZE that stay in cache for all of the batch.
+template <typename Curve>
+template <typename Add>
+void ParallelMultiexp<Curve>::scanBatch(std::vector<ParallelMultiexp*>& batch,
+                                        uint64_t idChunk, uint64_t begin,
+                                        uint64_t end, Add add)
+{
+    uint64_t perCopy = (glv ? 2 : 1) * nBases;
+
+    for (uint64_t pos = begin; pos < end;)
+    {
+        uint64_t copy = pos / perCopy;
+        uint64_t half = (pos - copy * perCopy) / nBases;
+        uint64_t lo   = pos - copy * perCopy - half * nBases;
+        uint64_t hi   = std::min<uint64_t>(
+            {nBases, lo + PME2_BATCH_BLOCK_SIZE, lo + end - pos});
+
+        for (uint64_t v = 0; v < batch.size(); v++)
+        {
+            ParallelMultiexp& pm = *batch[v];
+            uint64_t          j  = lo;
+            uint64_t          jEnd = hi;
+            if (pm.sparse)
+            {
+                j = std::lower_bound(pm.dense.begin(), pm.dense.end(), lo) -
+                    pm.dense.begin();
+                jEnd = std::lower_bound(pm.dense.begin() + j, pm.dense.end(),
+                                        hi) -
+                       pm.dense.begin();
+            }
+
+            for (; j < jEnd; j++)
+            {
+                uint64_t b   = pm.sparse ? pm.dense[j] : j;
+                uint64_t idx = half ? nBases + b : b;
+                int64_t  chunkValue =
+                    pm.getChunk(idx, copy * nChunks + idChunk);
+                if (chunkValue == 0)
+                    continue;
+
+                typename Curve::PointAffine  tmp;
+                typename Curve::PointAffine& base = getBase(copy, idx, tmp);
+                add(v, chunkValue, base);
+            }
+        }
+
+        pos += hi - lo;
+    }
+}
+
+// processWindow() for every multiexp of the batch, res[v] gets the window
+// of multiexp v.
+template <typename Curve>
+void ParallelMultiexp<Curve>::processWindowBatch(
+    std::vector<ParallelMultiexp*>& batch, typename Curve::Point* res,
+    uint64_t idChunk, uint64_t begin, uint64_t end)
+{
+    uint64_t k        = batch.size();
+    uint64_t idThread = tbb::this_task_arena::current_thread_index();
+
+    if (useBatchAffine())
+    {
+        typename Curve::PointAffine* buckets =
+            ws->buckets.get<typename Curve::PointAffine>(nThreads * k *
+                                                         accsPerChunk) +
+            idThread * k * accsPerChunk;
+        for (uint64_t i = 0; i < k * accsPerChunk; i++)
+            g.copy(buckets[i], g.zeroAffine());
+
+        std::vector<AffineBucketBatch<Curve>> batches;
+        batches.reserve(k);
+        for (uint64_t v = 0; v < k; v++)
+        {
+            batches.emplace_back(g);
+            batches[v].init(buckets + v * accsPerChunk, accsPerChunk,
+                            std::clamp<uint64_t>(accsPerChunk >> 4,
+                                                 PME2_MIN_AFFINE_BATCH_SIZE,
+                                                 PME2_MAX_AFFINE_BATCH_SIZE));
+        }
+
+        scanBatch(batch, idChunk, begin, end,
+                  [&](uint64_t v, int64_t chunkValue,
+                      typename Curve::PointAffine& base)
+                  {
+                      if (chunkValue > 0)
+                          batches[v].add(chunkValue, base, false);
+                      else
+                          batches[v].add(-chunkValue, base, true);
+                  });
+
+        for (uint64_t v = 0; v < k; v++)
+        {
+            batches[v].finish();
+
+            typename Curve::PointAffine* b = buckets + v * accsPerChunk;
+            typename Curve::Point        sum;
+            g.copy(sum, g.zero());
+            g.copy(res[v], g.zero());
+            for (uint64_t i = accsPerChunk - 1; i > 0; i--)
+            {
+                if (!g.isZero(b[i]))
+                    g.add(sum, sum, b[i]);
+                g.add(res[v], res[v], sum);
+            }
+        }
+    }
+    else
+    {
+        typename Curve::Point* buckets =
+            ws->buckets.get<typename Curve::Point>(nThreads * k *
+                                                   accsPerChunk) +
+            idThread * k * accsPerChunk;
+        for (uint64_t i = 0; i < k * accsPerChunk; i++)
+            g.copy(buckets[i], g.zero());
+
+        scanBatch(batch, idChunk, begin, end,
+                  [&](uint64_t v, int64_t chunkValue,
+                      typename Curve::PointAffine& base)
+                  {
+                      if (g.isZero(base))
+                          return;
+                      typename Curve::Point* b = buckets + v * accsPerChunk;
+                      if (chunkValue > 0)
+                          g.add(b[chunkValue], b[chunkValue], base);
+                      else
+                          g.sub(b[-chunkValue], b[-chunkValue], base);
+                  });
+
+        for (uint64_t v = 0; v < k; v++)
+        {
+            typename Curve::Point* b = buckets + v * accsPerChunk;
+            typename Curve::Point  sum;
+            g.copy(sum, g.zero());
+            g.copy(res[v], g.zero());
+            for (uint64_t i = accsPerChunk - 1; i > 0; i--)
+            {
+                g.add(sum, sum, b[i]);
+                g.add(res[v], res[v], sum);
+            }
+        }
+    }
+}
+
 #endif // PAR_MULTIEXP2
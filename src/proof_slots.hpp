@@ -0,0 +1,156 @@
+#ifndef PROOF_SLOTS_HPP
+#define PROOF_SLOTS_HPP
+
+#include "scope_guard.hpp"
+
+#include <tbb/info.h>
+#include <tbb/task_arena.h>
+#include <tbb/task_scheduler_observer.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#    include <pthread.h>
+#    include <sched.h>
+#endif
+
+// A fixed number of slots for the proofs, each a task arena with its own
+// threads, so that concurrent proofs split the cores instead of every one of
+// them spreading over all of them. A proof takes a free slot, or waits for
+// one. Inside a slot this_task_arena is the slot: the multiexps size their
+// buckets for its threads and index them within it.
+class ProofSlots
+{
+#ifdef __linux__
+    // Keeps the threads on a set of cores while they work in the arena.
+    class Pinning : public tbb::task_scheduler_observer
+    {
+        cpu_set_t cpus;
+        cpu_set_t all;
+
+    public:
+        Pinning(tbb::task_arena& arena, const cpu_set_t& _cpus,
+                const cpu_set_t& _all)
+            : tbb::task_scheduler_observer(arena)
+            , cpus(_cpus)
+            , all(_all)
+        {
+            observe(true);
+        }
+        ~Pinning() { observe(false); }
+
+        void on_scheduler_entry(bool) override
+        {
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        }
+        void on_scheduler_exit(bool) override
+        {
+            pthread_setaffinity_np(pthread_self(), sizeof(all), &all);
+        }
+    };
+#endif
+
+    struct Slot
+    {
+        // One of the threads is the caller, which joins the arena to run
+        // the proof.
+        tbb::task_arena arena;
+#ifdef __linux__
+        std::unique_ptr<Pinning> pinning;
+#endif
+
+        Slot(unsigned nThreads)
+            : arena(nThreads, 1)
+        {
+        }
+    };
+
+    std::vector<std::unique_ptr<Slot>> slots;
+    std::vector<Slot*>                 idle;
+    unsigned                           nThreads;
+    std::mutex                         lock;
+    std::condition_variable            freed;
+
+public:
+    // _nSlots arenas of _nThreads threads each, the cores split evenly among
+    // them when 0. With pin the slots get disjoint sets of the cores the
+    // process may run on, on Linux only.
+    ProofSlots(unsigned _nSlots, unsigned _nThreads = 0, bool pin = false)
+        : nThreads(_nThreads)
+    {
+        _nSlots = std::max(1u, _nSlots);
+        if (nThreads == 0)
+        {
+            nThreads = std::max(
+                1u, (unsigned)tbb::info::default_concurrency() / _nSlots);
+        }
+
+#ifdef __linux__
+        cpu_set_t all;
+        CPU_ZERO(&all);
+        sched_getaffinity(0, sizeof(all), &all);
+        std::vector<int> cpus;
+        for (int c = 0; c < CPU_SETSIZE; c++)
+        {
+            if (CPU_ISSET(c, &all))
+                cpus.push_back(c);
+        }
+#endif
+
+        for (unsigned i = 0; i < _nSlots; i++)
+        {
+            auto slot = std::make_unique<Slot>(nThreads);
+            slot->arena.initialize();
+#ifdef __linux__
+            if (pin && !cpus.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (unsigned j = 0; j < nThreads; j++)
+                    CPU_SET(cpus[(i * nThreads + j) % cpus.size()], &set);
+                slot->pinning =
+                    std::make_unique<Pinning>(slot->arena, set, all);
+            }
+#endif
+            idle.push_back(slot.get());
+            slots.push_back(std::move(slot));
+        }
+    }
+
+    ProofSlots(ProofSlots const&)            = delete;
+    ProofSlots& operator=(ProofSlots const&) = delete;
+
+    unsigned nSlots() { return slots.size(); }
+    unsigned threadsPerSlot() { return nThreads; }
+
+    // Runs f in a free slot, waiting for one if needed, and returns its
+    // result.
+    template <typename F>
+    auto run(F&& f) -> decltype(f())
+    {
+        Slot* slot;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            freed.wait(guard, [&] { return !idle.empty(); });
+            slot = idle.back();
+            idle.pop_back();
+        }
+        MAKE_SCOPE_EXIT(release_slot)
+        {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                idle.push_back(slot);
+            }
+            freed.notify_one();
+        };
+
+        return slot->arena.execute(std::forward<F>(f));
+    }
+};
+
+#endif // PROOF_SLOTS_HPP
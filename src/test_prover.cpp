@@ -1,11 +1,21 @@
+#include "alt_bn128.hpp"
+#include "fft.hpp"
 #include "fq.hpp"
 #include "fr.hpp"
+#include "fr_batch.hpp"
+#include "fullprover.hpp"
 #include <cstdint>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <tbb/task_arena.h>
+#include <vector>
+
+#ifdef USE_SODIUM
+#    include <sodium.h>
+#endif
 
 int tests_run    = 0;
 int tests_failed = 0;
@@ -58,6 +68,8 @@ bool is_equal(const PFrElement a, const PFrElement b)
     return std::memcmp(a, b, sizeof(FrElement)) == 0;
 }
 
+bool is_equal(const std::string& a, const std::string& b) { return a == b; }
+
 bool is_equal(const PFqElement a, const PFqElement b)
 {
     return std::memcmp(a, b, sizeof(FqElement)) == 0;
@@ -16287,6 +16299,640 @@ void Fq_bnot_unit_test()
     Fq_bnot_test(r23, m3, 23);
 }
 
+// Deterministic xorshift for the randomized tests.
+uint64_t test_random()
+{
+    static uint64_t s = 0x9e3779b97f4a7c15;
+
+    s ^= s << 13;
+    s ^= s >> 7;
+    s ^= s << 17;
+    return s;
+}
+
+// n random raw elements below 2^253, so below q of both fields, the first
+// and the last set to 0 and q - 1.
+void test_raw_elements(uint64_t* e, int n, const uint64_t q[4])
+{
+    for (int i = 0; i < n * 4; i++)
+    {
+        e[i] = test_random();
+    }
+    for (int i = 0; i < n; i++)
+    {
+        e[i * 4 + 3] >>= 3;
+    }
+    memset(e, 0, 4 * sizeof(uint64_t));
+    memcpy(e + (n - 1) * 4, q, 4 * sizeof(uint64_t));
+    e[(n - 1) * 4]--;
+}
+
+void Fr_rawBatch_unit_test()
+{
+    // Four vectors of eight and a tail.
+    const int n = 37;
+
+    RawFr::Element a[n], b[n], w[n], r[n], x[n], y[n];
+    FrRawElement   e, t;
+
+    test_raw_elements(a[0].v, n, Fr_q.longVal);
+    test_raw_elements(b[0].v, n, Fr_q.longVal);
+    test_raw_elements(w[0].v, n, Fr_q.longVal);
+    Fr_rawCopy(b[1].v, b[n - 1].v);
+    Fr_rawCopy(w[2].v, w[n - 1].v);
+
+    Fr_rawMMulBatch(r, a, b, n);
+    for (int i = 0; i < n; i++)
+    {
+        Fr_rawMMul(e, a[i].v, b[i].v);
+        compare_Result(e, r[i].v, a[i].v, b[i].v, i, "Fr_rawMMulBatch");
+    }
+
+    memcpy(r, a, sizeof(a));
+    Fr_rawMMulBatch(r, r, b, n);
+    for (int i = 0; i < n; i++)
+    {
+        Fr_rawMMul(e, a[i].v, b[i].v);
+        compare_Result(e, r[i].v, a[i].v, b[i].v, i,
+                       "Fr_rawMMulBatch aliased");
+    }
+
+    memcpy(x, a, sizeof(a));
+    memcpy(y, b, sizeof(b));
+    Fr_rawButterflyBatch(x, y, w, n);
+    for (int i = 0; i < n; i++)
+    {
+        Fr_rawMMul(t, w[i].v, b[i].v);
+        Fr_rawAdd(e, a[i].v, t);
+        compare_Result(e, x[i].v, a[i].v, b[i].v, i, "Fr_rawButterflyBatch");
+        Fr_rawSub(e, a[i].v, t);
+        compare_Result(e, y[i].v, a[i].v, b[i].v, i, "Fr_rawButterflyBatch");
+    }
+
+    // The inverse butterflies read the twiddles backwards from w[n - 1].
+    memcpy(x, a, sizeof(a));
+    memcpy(y, b, sizeof(b));
+    Fr_rawInvButterflyBatch(x, y, w + n - 1, n);
+    for (int i = 0; i < n; i++)
+    {
+        Fr_rawAdd(e, a[i].v, b[i].v);
+        compare_Result(e, x[i].v, a[i].v, b[i].v, i,
+                       "Fr_rawInvButterflyBatch");
+        Fr_rawSub(t, a[i].v, b[i].v);
+        Fr_rawMMul(e, t, w[n - 1 - i].v);
+        compare_Result(e, y[i].v, a[i].v, b[i].v, i,
+                       "Fr_rawInvButterflyBatch");
+    }
+}
+
+// batchInverse and parallelBatchInverse against inv, zeros mapping to zero.
+template <typename Field>
+void batchInverse_test(Field& f, std::vector<typename Field::Element>& a,
+                       std::string name)
+{
+    std::vector<typename Field::Element> r(a.size()), p(a.size());
+    typename Field::Element              e;
+
+    f.batchInverse(r.data(), a.data(), a.size());
+    parallelBatchInverse(f, p.data(), a.data(), a.size());
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        if (f.isZero(a[i]))
+        {
+            f.copy(e, f.zero());
+        }
+        else
+        {
+            f.inv(e, a[i]);
+        }
+        if (!f.eq(e, r[i]) || !f.eq(e, p[i]))
+        {
+            std::cout << name << " batchInverse:" << i << " failed!"
+                      << std::endl;
+            tests_failed++;
+        }
+        tests_run++;
+    }
+}
+
+// Over several chunks of parallelBatchInverse, with every fifth element
+// zero, and for F2 every seventh with a zero half only.
+void batchInverse_unit_test()
+{
+    const int n = 2 * BATCH_INVERSE_CHUNK + 37;
+
+    std::vector<RawFr::Element>      r(n);
+    std::vector<RawFq::Element>      q(n), qb(n);
+    std::vector<AltBn128::F2Element> f2(n);
+
+    test_raw_elements(r[0].v, n, Fr_q.longVal);
+    test_raw_elements(q[0].v, n, Fq_q.longVal);
+    test_raw_elements(qb[0].v, n, Fq_q.longVal);
+    for (int i = 0; i < n; i++)
+    {
+        if (i % 5 == 2)
+        {
+            memset(r[i].v, 0, sizeof(r[i].v));
+            memset(q[i].v, 0, sizeof(q[i].v));
+            memset(qb[i].v, 0, sizeof(qb[i].v));
+        }
+        f2[i].a = q[i];
+        f2[i].b = qb[i];
+        if (i % 7 == 3)
+        {
+            memset(f2[i].a.v, 0, sizeof(f2[i].a.v));
+        }
+    }
+
+    batchInverse_test(AltBn128::Fr, r, "RawFr");
+    batchInverse_test(AltBn128::F1, q, "RawFq");
+    batchInverse_test(AltBn128::F2, f2, "F2Field");
+}
+
+// w / 2^256 mod q of Fq, with GMP.
+void Fq_mreduce_expected(FqRawElement r, const FqRawWideElement w)
+{
+    mpz_t a, q, rinv;
+
+    mpz_inits(a, q, rinv, NULL);
+    mpz_import(a, 8, -1, 8, 0, 0, w);
+    mpz_import(q, 4, -1, 8, 0, 0, Fq_q.longVal);
+    mpz_setbit(rinv, 256);
+    mpz_invert(rinv, rinv, q);
+    mpz_mul(a, a, rinv);
+    mpz_mod(a, a, q);
+    memset(r, 0, sizeof(FqRawElement));
+    mpz_export(r, NULL, -1, 8, 0, 0, a);
+    mpz_clears(a, q, rinv, NULL);
+}
+
+void Fq_rawWide_unit_test()
+{
+    const int n = 16;
+
+    FqRawElement     a[n], b[n], e, r;
+    FqRawWideElement w, p;
+
+    test_raw_elements(a[0], n, Fq_q.longVal);
+    test_raw_elements(b[0], n, Fq_q.longVal);
+
+    // Products of reduced elements against Fq_rawMMul, and of lazily added
+    // ones below 2q against GMP.
+    for (int i = 0; i < n; i++)
+    {
+        Fq_rawMulWide(w, a[i], b[i]);
+        mpn_mul_n(p, a[i], b[i], 4);
+        compare_Result(p, w, a[i], b[i], i, "Fq_rawMulWide low");
+        compare_Result(p + 4, w + 4, a[i], b[i], i, "Fq_rawMulWide high");
+
+        Fq_rawMReduceWide(r, w);
+        Fq_rawMMul(e, a[i], b[i]);
+        compare_Result(e, r, a[i], b[i], i, "Fq_rawMReduceWide");
+
+        FqRawElement a2, b2;
+        mpn_add_n(a2, a[i], Fq_q.longVal, 4);
+        mpn_add_n(b2, b[i], Fq_q.longVal, 4);
+        Fq_rawMulWide(w, a2, b2);
+        Fq_rawMReduceWide(r, w);
+        Fq_mreduce_expected(e, w);
+        compare_Result(e, r, a2, b2, i, "Fq_rawMReduceWide lazy");
+    }
+
+    // Double width values up to q * 2^256 - 1, the top of the range.
+    for (int i = 0; i < n; i++)
+    {
+        memcpy(w, a[i], sizeof(FqRawElement));
+        memcpy(w + 4, b[i], sizeof(FqRawElement));
+        if (i == n - 1)
+        {
+            memset(w, 0xff, sizeof(FqRawElement));
+        }
+        Fq_rawMReduceWide(r, w);
+        Fq_mreduce_expected(e, w);
+        compare_Result(e, r, w, w + 4, i, "Fq_rawMReduceWide range");
+    }
+}
+
+#if defined(USE_ASM) && defined(ARCH_X86_64)
+
+// The baseline x86-64 kernels against the BMI2/ADX ones, on the same
+// inputs. Only hosts with ADX can run both.
+void raw_kernels_unit_test()
+{
+    if (strcmp(Fq_rawKernel(), "bmi2/adx") != 0 ||
+        strcmp(Fr_rawKernel(), "bmi2/adx") != 0)
+    {
+        std::cout << "raw_kernels_unit_test: no BMI2/ADX, skipped"
+                  << std::endl;
+        return;
+    }
+
+    const int n = 16;
+
+    FqRawElement     qa[n], qb[n], qe, qr;
+    FrRawElement     ra[n], rb[n], re, rr;
+    FqRawWideElement we, wr;
+
+    test_raw_elements(qa[0], n, Fq_q.longVal);
+    test_raw_elements(qb[0], n, Fq_q.longVal);
+    test_raw_elements(ra[0], n, Fr_q.longVal);
+    test_raw_elements(rb[0], n, Fr_q.longVal);
+
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t b1 = test_random();
+
+        Fq_baseline::Fq_rawMMul(qe, qa[i], qb[i]);
+        Fq_rawMMulAdx(qr, qa[i], qb[i]);
+        compare_Result(qe, qr, qa[i], qb[i], i, "Fq_rawMMul baseline");
+        Fq_baseline::Fq_rawMSquare(qe, qa[i]);
+        Fq_rawMSquareAdx(qr, qa[i]);
+        compare_Result(qe, qr, qa[i], i, "Fq_rawMSquare baseline");
+        Fq_baseline::Fq_rawMMul1(qe, qa[i], b1);
+        Fq_rawMMul1Adx(qr, qa[i], b1);
+        compare_Result(qe, qr, qa[i], i, "Fq_rawMMul1 baseline");
+        Fq_baseline::Fq_rawToMontgomery(qe, qa[i]);
+        Fq_rawToMontgomeryAdx(qr, qa[i]);
+        compare_Result(qe, qr, qa[i], i, "Fq_rawToMontgomery baseline");
+        Fq_baseline::Fq_rawFromMontgomery(qe, qa[i]);
+        Fq_rawFromMontgomeryAdx(qr, qa[i]);
+        compare_Result(qe, qr, qa[i], i, "Fq_rawFromMontgomery baseline");
+        Fq_baseline::Fq_rawMulWide(we, qa[i], qb[i]);
+        Fq_rawMulWideAdx(wr, qa[i], qb[i]);
+        compare_Result(we, wr, qa[i], qb[i], i, "Fq_rawMulWide baseline");
+        compare_Result(we + 4, wr + 4, qa[i], qb[i], i,
+                       "Fq_rawMulWide baseline");
+        Fq_baseline::Fq_rawMReduceWide(qe, we);
+        Fq_rawMReduceWideAdx(qr, we);
+        compare_Result(qe, qr, qa[i], qb[i], i, "Fq_rawMReduceWide baseline");
+
+        Fr_baseline::Fr_rawMMul(re, ra[i], rb[i]);
+        Fr_rawMMulAdx(rr, ra[i], rb[i]);
+        compare_Result(re, rr, ra[i], rb[i], i, "Fr_rawMMul baseline");
+        Fr_baseline::Fr_rawMSquare(re, ra[i]);
+        Fr_rawMSquareAdx(rr, ra[i]);
+        compare_Result(re, rr, ra[i], i, "Fr_rawMSquare baseline");
+        Fr_baseline::Fr_rawMMul1(re, ra[i], b1);
+        Fr_rawMMul1Adx(rr, ra[i], b1);
+        compare_Result(re, rr, ra[i], i, "Fr_rawMMul1 baseline");
+        Fr_baseline::Fr_rawToMontgomery(re, ra[i]);
+        Fr_rawToMontgomeryAdx(rr, ra[i]);
+        compare_Result(re, rr, ra[i], i, "Fr_rawToMontgomery baseline");
+        Fr_baseline::Fr_rawFromMontgomery(re, ra[i]);
+        Fr_rawFromMontgomeryAdx(rr, ra[i]);
+        compare_Result(re, rr, ra[i], i, "Fr_rawFromMontgomery baseline");
+    }
+}
+
+#endif
+
+// MontField against the generated field on random elements. Both keep the
+// elements in Montgomery form with R = 2^256, so they match limb for limb.
+template <typename Mont, typename Raw>
+void MontField_test(Mont& m, Raw& f, const uint64_t q[4], std::string name)
+{
+    const int n = 16;
+
+    typename Raw::Element  a[n], b[n], r;
+    typename Mont::Element x, y, t;
+
+    test_raw_elements(a[0].v, n, q);
+    test_raw_elements(b[0].v, n, q);
+
+    for (int i = 0; i < n; i++)
+    {
+        memcpy(x.v, a[i].v, sizeof(x.v));
+        memcpy(y.v, b[i].v, sizeof(y.v));
+
+        f.add(r, a[i], b[i]);
+        m.add(t, x, y);
+        compare_Result(r.v, t.v, a[i].v, b[i].v, i, name + " add");
+        f.sub(r, a[i], b[i]);
+        m.sub(t, x, y);
+        compare_Result(r.v, t.v, a[i].v, b[i].v, i, name + " sub");
+        f.mul(r, a[i], b[i]);
+        m.mul(t, x, y);
+        compare_Result(r.v, t.v, a[i].v, b[i].v, i, name + " mul");
+        f.square(r, a[i]);
+        m.square(t, x);
+        compare_Result(r.v, t.v, a[i].v, i, name + " square");
+        f.neg(r, a[i]);
+        m.neg(t, x);
+        compare_Result(r.v, t.v, a[i].v, i, name + " neg");
+        f.toMontgomery(r, a[i]);
+        m.toMontgomery(t, x);
+        compare_Result(r.v, t.v, a[i].v, i, name + " toMontgomery");
+        f.fromMontgomery(r, a[i]);
+        m.fromMontgomery(t, x);
+        compare_Result(r.v, t.v, a[i].v, i, name + " fromMontgomery");
+        if (!f.isZero(a[i]))
+        {
+            f.inv(r, a[i]);
+            m.inv(t, x);
+            compare_Result(r.v, t.v, a[i].v, i, name + " inv");
+        }
+        if (f.toString(a[i]) != m.toString(x))
+        {
+            std::cout << name << " toString:" << i << " failed!" << std::endl;
+            tests_failed++;
+        }
+        tests_run++;
+    }
+}
+
+// Multiples of the generator with Curve<MontFq> and Curve<RawFq>, single and
+// multiexp.
+void MontCurve_test()
+{
+    const int n = 40;
+
+    AltBn128::MontFq        mq;
+    Curve<AltBn128::MontFq> gm(mq, "0", "3", "1", "2");
+    Curve<RawFq>&           gr = AltBn128::Engine::engine.g1;
+
+    Curve<AltBn128::MontFq>::PointAffine basesM[n];
+    Curve<RawFq>::PointAffine            basesR[n];
+    Curve<AltBn128::MontFq>::Point       pm, accM;
+    Curve<RawFq>::Point                  pr, accR;
+    Curve<AltBn128::MontFq>::PointAffine am;
+    Curve<RawFq>::PointAffine            ar;
+    RawFr::Element                       scalars[n];
+
+    test_raw_elements(scalars[0].v, n, Fr_q.longVal);
+    gm.copy(accM, gm.one());
+    gr.copy(accR, gr.one());
+    for (int i = 0; i < n; i++)
+    {
+        gm.copy(basesM[i], accM);
+        gr.copy(basesR[i], accR);
+        gm.add(accM, accM, gm.one());
+        gr.add(accR, accR, gr.one());
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        gm.mulByScalar(pm, basesM[i], (uint8_t*)scalars[i].v, 32);
+        gr.mulByScalar(pr, basesR[i], (uint8_t*)scalars[i].v, 32);
+        gm.copy(am, pm);
+        gr.copy(ar, pr);
+        compare_Result(ar.x.v, am.x.v, scalars[i].v, i,
+                       "MontCurve mulByScalar");
+        compare_Result(ar.y.v, am.y.v, scalars[i].v, i,
+                       "MontCurve mulByScalar");
+    }
+
+    gm.multiMulByScalar(pm, basesM, (uint8_t*)scalars, 32, n);
+    gr.multiMulByScalar(pr, basesR, (uint8_t*)scalars, 32, n);
+    gm.copy(am, pm);
+    gr.copy(ar, pr);
+    compare_Result(ar.x.v, am.x.v, scalars[0].v, 0,
+                   "MontCurve multiMulByScalar");
+    compare_Result(ar.y.v, am.y.v, scalars[0].v, 0,
+                   "MontCurve multiMulByScalar");
+}
+
+// FFT<MontFr> against FFT<RawFr>, forward and inverse.
+// Multiexps under memory budgets against the unbounded one. The arena has
+// more threads than buckets fit for, so that the sorted mode runs too.
+void multiexpBudget_test()
+{
+    const int n = 3000;
+
+    Curve<RawFq>&                          g = AltBn128::Engine::engine.g1;
+    std::vector<Curve<RawFq>::PointAffine> bases(n);
+    std::vector<RawFr::Element>            scalars(n);
+    Curve<RawFq>::Point                    acc, expected, p;
+    Curve<RawFq>::PointAffine              ae, ap;
+
+    test_raw_elements(scalars[0].v, n, Fr_q.longVal);
+    g.copy(acc, g.one());
+    for (int i = 0; i < n; i++)
+    {
+        g.copy(bases[i], acc);
+        g.add(acc, acc, g.one());
+        g.dbl(acc, acc);
+    }
+
+    tbb::task_arena arena(8);
+    arena.execute(
+        [&]
+        {
+            g.multiMulByScalar(expected, bases.data(), (uint8_t*)scalars.data(),
+                               32, n);
+            g.copy(ae, expected);
+
+            FixedBaseTable<Curve<RawFq>> table;
+            g.precomputeBases(table, bases.data(), 32, n, 3);
+
+            uint64_t budgets[] = {1, 4096, 1 << 16};
+            for (int i = 0; i < 3; i++)
+            {
+                MultiexpWorkspace ws;
+                ws.memoryBudget = budgets[i];
+
+                g.multiMulByScalar(p, bases.data(), (uint8_t*)scalars.data(),
+                                   32, n, 0, &ws);
+                g.copy(ap, p);
+                compare_Result(ae.x.v, ap.x.v, scalars[0].v, i,
+                               "multiMulByScalar with budget");
+                compare_Result(ae.y.v, ap.y.v, scalars[0].v, i,
+                               "multiMulByScalar with budget");
+
+                g.multiMulByScalar(p, table, (uint8_t*)scalars.data(), &ws);
+                g.copy(ap, p);
+                compare_Result(ae.x.v, ap.x.v, scalars[0].v, i,
+                               "multiMulByScalar table with budget");
+                compare_Result(ae.y.v, ap.y.v, scalars[0].v, i,
+                               "multiMulByScalar table with budget");
+            }
+        });
+}
+
+// Multiexps of several plans in one batch against the naive sums, with and
+// without a table, for a dense, a sparse and a small scalar vector.
+void multiexpBatch_test()
+{
+    const int n      = 2000;
+    const int k      = 3;
+    const int offset = 7;
+
+    typedef Curve<RawFq> G1;
+
+    G1&                          g = AltBn128::Engine::engine.g1;
+    std::vector<G1::PointAffine> bases(n);
+    std::vector<RawFr::Element>  scalars(k * n);
+    G1::Point                    acc, p, r[k];
+    G1::Point                    expected[k], expectedSuffix[k];
+    G1::PointAffine              ae, ar;
+
+    test_raw_elements(scalars[0].v, k * n, Fr_q.longVal);
+    for (int i = 0; i < n; i++)
+    {
+        RawFr::Element& sparse = scalars[n + i];
+        RawFr::Element& small  = scalars[2 * n + i];
+        if (i % 4 != 0)
+            memset(sparse.v, 0, sizeof(sparse.v));
+        if (i % 4 == 1)
+            sparse.v[0] = 1;
+        if (i % 4 == 2)
+            sparse.v[0] = i;
+        memset(small.v + 1, 0, 3 * sizeof(uint64_t));
+        small.v[0] &= 0xFFFF;
+    }
+
+    g.copy(acc, g.one());
+    for (int i = 0; i < n; i++)
+    {
+        g.copy(bases[i], acc);
+        g.add(acc, acc, g.one());
+        g.dbl(acc, acc);
+    }
+
+    for (int v = 0; v < k; v++)
+    {
+        g.copy(expected[v], g.zero());
+        g.copy(expectedSuffix[v], g.zero());
+        for (int i = 0; i < n; i++)
+        {
+            g.mulByScalar(p, bases[i], (uint8_t*)scalars[v * n + i].v, 32);
+            g.add(expected[v], expected[v], p);
+            if (i >= offset)
+                g.add(expectedSuffix[v], expectedSuffix[v], p);
+        }
+    }
+
+    auto compare = [&](G1::Point* e, std::string name)
+    {
+        for (int v = 0; v < k; v++)
+        {
+            g.copy(ae, e[v]);
+            g.copy(ar, r[v]);
+            compare_Result(ae.x.v, ar.x.v, scalars[v * n].v, v, name);
+            compare_Result(ae.y.v, ar.y.v, scalars[v * n].v, v, name);
+        }
+    };
+
+    FixedBaseTable<G1> table;
+    g.precomputeBases(table, bases.data(), 32, n, 3);
+
+    ScalarPlan  plans[k], tablePlans[k];
+    ScalarPlan* pp[k];
+    ScalarPlan* ppt[k];
+    for (int v = 0; v < k; v++)
+    {
+        g.planScalars(plans[v], (uint8_t*)scalars[v * n].v, 32, n);
+        g.planScalars(tablePlans[v], (uint8_t*)scalars[v * n].v, 32, n,
+                      table.bitsPerChunk,
+                      table.nCopies() * table.chunksPerCopy);
+        pp[v]  = &plans[v];
+        ppt[v] = &tablePlans[v];
+    }
+
+    g.multiMulByScalar(r, bases.data(), pp, k, 0, n);
+    compare(expected, "multiMulByScalar batch");
+    g.multiMulByScalar(r, bases.data() + offset, pp, k, offset, n - offset);
+    compare(expectedSuffix, "multiMulByScalar batch with offset");
+    g.multiMulByScalar(r, table, ppt, k, 0);
+    compare(expected, "multiMulByScalar batch table");
+
+    // Too small a budget for the buckets of the batch, the multiexps run
+    // one by one.
+    MultiexpWorkspace ws;
+    ws.memoryBudget = 1 << 16;
+    g.multiMulByScalar(r, bases.data(), pp, k, 0, n, &ws);
+    compare(expected, "multiMulByScalar batch with budget");
+}
+
+#ifdef USE_SODIUM
+
+// Random bytes that restart with proof_random_reset(), so that the proofs of
+// a witness come out the same however they are computed.
+uint64_t proof_random_state;
+
+void proof_random_reset() { proof_random_state = 0x2545f4914f6cdd1d; }
+
+uint32_t proof_random()
+{
+    proof_random_state ^= proof_random_state << 13;
+    proof_random_state ^= proof_random_state >> 7;
+    proof_random_state ^= proof_random_state << 17;
+    return proof_random_state >> 32;
+}
+
+void proof_random_buf(void* const buf, const size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        ((uint8_t*)buf)[i] = proof_random();
+    }
+}
+
+const char* proof_random_name() { return "test"; }
+
+randombytes_implementation proof_random_implementation = {
+    proof_random_name, proof_random, nullptr, nullptr, proof_random_buf,
+    nullptr};
+
+// Batched proofs against single proofs of the same witnesses, with the same
+// random bytes. The batch spans several groups of proveBatch(). Run from the
+// root of the repository.
+void proveBatch_test()
+{
+    const int   n    = 9;
+    const char* wtns = "testdata/witness.wtns";
+
+    randombytes_set_implementation(&proof_random_implementation);
+
+    FullProver               prover("testdata/circuit_final.zkey");
+    std::vector<std::string> single;
+
+    proof_random_reset();
+    for (int i = 0; i < n; i++)
+    {
+        ProverResponse res = prover.prove(wtns);
+        single.push_back(res.type == SUCCESS ? res.raw_json : "error");
+    }
+
+    std::vector<const char*> inputs(n, wtns);
+    proof_random_reset();
+    auto batch = prover.proveBatch(inputs.data(), n);
+
+    for (int i = 0; i < n; i++)
+    {
+        std::string proof =
+            batch[i]->type == SUCCESS ? batch[i]->raw_json : "batch error";
+        compare_Result(single[i], proof, wtns, i, "proveBatch");
+    }
+}
+
+#endif // USE_SODIUM
+
+void MontFFT_test()
+{
+    const int n = 64;
+
+    FFT<AltBn128::MontFr>     fm(n);
+    FFT<RawFr>                fr(n);
+    AltBn128::MontFr::Element a[n];
+    RawFr::Element            b[n];
+
+    test_raw_elements(b[0].v, n, Fr_q.longVal);
+    memcpy(a, b, sizeof(b));
+
+    fm.fft(a, n);
+    fr.fft(b, n);
+    for (int i = 0; i < n; i++)
+    {
+        compare_Result(b[i].v, a[i].v, b[i].v, i, "MontFFT fft");
+    }
+    fm.ifft(a, n);
+    fr.ifft(b, n);
+    for (int i = 0; i < n; i++)
+    {
+        compare_Result(b[i].v, a[i].v, b[i].v, i, "MontFFT ifft");
+    }
+}
+
 void print_results()
 {
     std::cout << "Results: " << std::dec << tests_run << " tests were run, "
@@ -16565,6 +17211,24 @@ int xxmain()
     Fq_leq_s1l2n_unit_test();
     Fq_lnot_unit_test();
 
+    Fr_rawBatch_unit_test();
+    Fq_rawWide_unit_test();
+    batchInverse_unit_test();
+#if defined(USE_ASM) && defined(ARCH_X86_64)
+    raw_kernels_unit_test();
+#endif
+    MontField_test(AltBn128::MontFq::field, AltBn128::F1, Fq_q.longVal,
+                   "MontFq");
+    MontField_test(AltBn128::MontFr::field, AltBn128::Fr, Fr_q.longVal,
+                   "MontFr");
+    MontCurve_test();
+    MontFFT_test();
+    multiexpBudget_test();
+    multiexpBatch_test();
+#ifdef USE_SODIUM
+    proveBatch_test();
+#endif
+
     print_results();
 
     return tests_failed ? EXIT_FAILURE : EXIT_SUCCESS;
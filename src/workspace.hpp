@@ -0,0 +1,99 @@
+#ifndef WORKSPACE_HPP
+#define WORKSPACE_HPP
+
+#include <sys/mman.h>
+#include <tbb/parallel_for.h>
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+// Buffers are mapped in multiples of this size, aligned to it, so that they
+// can be backed by transparent huge pages.
+#ifndef WORKSPACE_HUGE_PAGE_SIZE
+#    define WORKSPACE_HUGE_PAGE_SIZE (uint64_t(2) << 20)
+#endif
+#define WORKSPACE_PAGE_SIZE 4096
+
+// Scratch memory reused across calls. It only grows: get() maps a larger
+// buffer when the current one is too small, losing its contents, and
+// otherwise returns the same memory. New buffers are first touched in
+// parallel, so that their pages are faulted in once, up front, and on the
+// nodes of the threads that will use them.
+class WorkspaceBuffer
+{
+    uint8_t* data     = nullptr;
+    uint64_t capacity = 0;
+
+    void release()
+    {
+        if (data)
+            munmap(data, capacity);
+        data     = nullptr;
+        capacity = 0;
+    }
+
+public:
+    WorkspaceBuffer() = default;
+    ~WorkspaceBuffer() { release(); }
+
+    WorkspaceBuffer(WorkspaceBuffer const&)            = delete;
+    WorkspaceBuffer& operator=(WorkspaceBuffer const&) = delete;
+
+    void reserve(uint64_t bytes)
+    {
+        if (bytes <= capacity)
+            return;
+        release();
+
+        uint64_t size = (bytes + WORKSPACE_HUGE_PAGE_SIZE - 1) /
+                        WORKSPACE_HUGE_PAGE_SIZE * WORKSPACE_HUGE_PAGE_SIZE;
+
+        // Over-map by a huge page and trim both ends to align the buffer.
+        uint64_t mapped = size + WORKSPACE_HUGE_PAGE_SIZE;
+        void*    p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+
+        uint8_t* begin   = (uint8_t*)p;
+        uint8_t* aligned = (uint8_t*)(((uintptr_t)begin +
+                                       WORKSPACE_HUGE_PAGE_SIZE - 1) &
+                                      ~(uintptr_t)(WORKSPACE_HUGE_PAGE_SIZE - 1));
+        if (aligned > begin)
+            munmap(begin, aligned - begin);
+        if (begin + mapped > aligned + size)
+            munmap(aligned + size, begin + mapped - (aligned + size));
+
+#ifdef MADV_HUGEPAGE
+        madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+
+        tbb::parallel_for(
+            tbb::blocked_range<uint64_t>(0, size / WORKSPACE_HUGE_PAGE_SIZE, 1),
+            [&](auto range)
+            {
+                for (uint64_t i = range.begin() * WORKSPACE_HUGE_PAGE_SIZE;
+                     i < range.end() * WORKSPACE_HUGE_PAGE_SIZE;
+                     i += WORKSPACE_PAGE_SIZE)
+                {
+                    aligned[i] = 0;
+                }
+            });
+
+        data     = aligned;
+        capacity = size;
+    }
+
+    // Room for n elements of T, uninitialized after growing.
+    template <typename T>
+    T* get(uint64_t n)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "workspace elements are not constructed");
+        reserve(n * sizeof(T));
+        return (T*)data;
+    }
+};
+
+#endif // WORKSPACE_HPP